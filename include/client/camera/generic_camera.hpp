@@ -3,9 +3,11 @@
 #include <atomic>
 #include <functional>
 #include <iostream>
+#include <memory>
 #include <thread>
 
 #include "base_camera.hpp"
+#include "client/ipc/shm_packet_ring.hpp"
 
 class generic_camera : public base_camera {
  protected:
@@ -21,8 +23,15 @@ class generic_camera : public base_camera {
   std::atomic<bool> video_capture;
   std::atomic<bool> object_detection;
 
+  // Encoded RTP packets go here instead of a network stream when set
+  std::shared_ptr<shm_packet_ring> packet_ring;
+
   virtual auto detect_objects() -> void {}
 
+  auto publish_packet(const void* data, size_t len, int64_t timestamp_ns) -> bool {
+    return packet_ring && packet_ring->publish(data, len, timestamp_ns);
+  }
+
  public:
   generic_camera();
   virtual ~generic_camera() = default;
@@ -37,4 +46,9 @@ class generic_camera : public base_camera {
   virtual auto set_on_human_lost(std::function<void()>&& callback) noexcept -> void {
     on_human_lost = std::move(callback);
   }
+
+  // Must be set before start()
+  virtual auto set_packet_ring(std::shared_ptr<shm_packet_ring> ring) noexcept -> void {
+    packet_ring = std::move(ring);
+  }
 };
\ No newline at end of file
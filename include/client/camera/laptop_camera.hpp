@@ -1,19 +1,39 @@
 #pragma once
 
 #include <atomic>
+#include <cstdint>
 #include <functional>
 #include <iostream>
 #include <thread>
 
 #include "generic_camera.hpp"
 
+// Simulated camera, publishes a synthetic H.264 RTP stream into the packet ring so the
+// shared memory ingest path can be exercised without camera hardware
 class laptop_camera final : public generic_camera {
  protected:
   auto detect_objects() -> void override;
 
  private:
+  constexpr static uint8_t PAYLOAD_TYPE = 96;
+  constexpr static uint32_t SSRC = 0x4C415054;    // "LAPT"
+  constexpr static uint32_t CLOCK_RATE = 90000;   // H.264 RTP clock
+  constexpr static uint32_t FPS = 60;
+  constexpr static uint32_t GOP_SIZE = 60;        // one IDR per second
+  constexpr static size_t MAX_PAYLOAD = 1200;     // keeps packets below a typical MTU
+  constexpr static size_t IDR_SIZE = 12000;       // synthetic frame sizes, only the NAL structure matters
+  constexpr static size_t SLICE_SIZE = 2000;
+
+  std::thread stream_thread;
   std::atomic<bool> human_detected{false};
+
+  uint16_t rtp_seq{0};
+  uint32_t rtp_timestamp{0};
+
   auto process_objects() -> void;
+  auto stream_video() -> void;
+  auto publish_frame(uint8_t nal_header, size_t size) -> void;
+  auto publish_rtp(const uint8_t* payload, size_t len, bool marker) -> void;
 
  public:
   laptop_camera();
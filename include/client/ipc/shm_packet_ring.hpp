@@ -0,0 +1,88 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// Single-producer / multi-consumer ring of encoded packets in a POSIX shared memory mapping
+//
+// A camera publishes RTP packets straight into the mapping and camera_streamer reads them without a socket,
+// replacing the UDP loopback hop (one kernel round trip and copy per packet)
+// Every consumer owns its cursor, a consumer that falls more than a ring behind skips ahead and counts the loss
+// Slots are guarded by a per-slot sequence number (seqlock), the producer never waits for consumers
+//
+// Wakeups go through an eventfd that only gets written when a consumer has armed it after draining the ring,
+// so a busy stream costs no syscalls on either side. The eventfd lives in this process: a producer in
+// another process can publish into the same mapping, but its consumers have to poll
+
+class shm_packet_ring {
+ public:
+  constexpr static uint64_t MAGIC = 0x5250524E47304331;  // "RPRNG0C1"
+  constexpr static uint32_t VERSION = 1;
+
+  struct cursor {
+    uint64_t next{0};
+    uint64_t lost{0};
+  };
+
+ private:
+  struct alignas(64) header {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t slot_count;  // power of two
+    uint32_t slot_size;   // payload bytes per slot
+    alignas(64) std::atomic<uint64_t> write_seq;
+    alignas(64) std::atomic<uint32_t> armed;  // a consumer is waiting for the eventfd
+  };
+
+  struct alignas(64) slot {
+    std::atomic<uint64_t> seq;  // 2 * n + 1 while packet n is written, 2 * n + 2 once committed
+    uint32_t len;
+    int64_t timestamp_ns;
+    // slot_size bytes of payload follow
+  };
+
+  std::string name;
+  bool owner;
+  int shm_fd;
+  int event_fd;
+  void *mapping;
+  size_t mapping_size;
+  size_t stride;  // bytes per slot including its header
+
+  header *hdr() const { return static_cast<header *>(mapping); }
+  slot *slot_at(uint64_t n) const;
+
+  shm_packet_ring(std::string name, bool owner);
+
+ public:
+  shm_packet_ring(const shm_packet_ring &) = delete;
+  shm_packet_ring &operator=(const shm_packet_ring &) = delete;
+  ~shm_packet_ring();
+
+  // Creates (or replaces) the named mapping, slot_count is rounded up to a power of two
+  static auto create(const std::string &name, uint32_t slot_count, uint32_t slot_size)
+      -> std::shared_ptr<shm_packet_ring>;
+
+  // Attaches to a mapping created by another process, throws if the layout does not match
+  static auto open(const std::string &name) -> std::shared_ptr<shm_packet_ring>;
+
+  // Producer side, never blocks, packets larger than a slot are rejected
+  bool publish(const void *data, size_t len, int64_t timestamp_ns = 0);
+
+  // Consumer side, copies the next packet into buffer, returns 0 when the ring is drained
+  size_t read(cursor &cur, void *buffer, size_t capacity, int64_t *timestamp_ns = nullptr) const;
+
+  // Starts a consumer at the newest packet
+  cursor subscribe() const;
+
+  // Asks the producer to signal the eventfd on its next publish, returns false if data is already pending
+  bool arm(const cursor &cur);
+  void clear_notification() const;
+
+  int get_event_fd() const { return event_fd; }
+  const std::string &get_name() const { return name; }
+  uint32_t get_slot_size() const { return hdr()->slot_size; }
+};
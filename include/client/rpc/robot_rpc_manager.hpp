@@ -2,29 +2,59 @@
 #include <grpcpp/grpcpp.h>
 #include <quill/Logger.h>
 
+#include <chrono>
+#include <condition_variable>
 #include <functional>
 #include <memory>
 #include <mutex>
 #include <rtc/rtc.hpp>
+#include <thread>
+#include <vector>
 
+#include "client/ipc/shm_packet_ring.hpp"
+#include "client/sessions/peer_link.hpp"
 #include "common/chat_type.hpp"
 #include "common/sessions/base_session.hpp"
+#include "common/sessions/session_table.hpp"
+#include "common/utils/timer_wheel.hpp"
 #include "grpc/robot.grpc.pb.h"
 #include "grpc/server.grpc.pb.h"
 
 class robot_rpc_manager final : public robot::robot_service::Service {
  private:
   constexpr static size_t MAX_SESSIONS = 10;
+  constexpr static auto RECLAIM_INTERVAL = std::chrono::seconds(10);  // backstop, sessions report going inactive
+  constexpr static int RTP_PORT = 6000;  // UDP fallback when the camera cannot publish into a packet ring
   std::shared_ptr<grpc::Channel> channel;
   std::shared_ptr<server::server_service::Stub> stub;
+  std::shared_ptr<peer_link> link;  // one peer connection to the server shared by all sessions, opened lazily
 
-  std::unordered_map<std::string, std::shared_ptr<base_session>> sessions;
-  mutable std::mutex mtx;  // to protect sessions map
+  // Every session has a reclaim timer on the shared wheel, fired right away when the session goes inactive
+  struct session_entry {
+    std::shared_ptr<base_session> session;
+    timer_wheel::timer_id reclaim_timer;
+  };
 
-  std::thread periodic_thread;
-  std::atomic<bool> is_running;
+  std::shared_ptr<timer_wheel> timers;
+  session_table<session_entry> sessions{MAX_SESSIONS};  // sharded, sessions are built outside its locks
 
-  void cleanup_sessions();
+  std::shared_ptr<shm_packet_ring> packet_ring;
+
+  // Publishes a session built under a reservation and arms its reclaim timer, false if the id is taken
+  bool add_session(session_table<session_entry>::reservation&& slot, const std::string& session_id,
+                   std::shared_ptr<base_session> session);
+
+  // Reclaimed sessions are released here rather than on the shared wheel thread, a streamer's destructor returns
+  // its track to the link and waits for the capture reactor, which would hold up every timer of the process
+  std::mutex reaper_mtx;
+  std::condition_variable reaper_cv;
+  std::vector<std::shared_ptr<base_session>> reaped;
+  bool reaper_stopping{false};
+  std::thread reaper_thread;
+
+  // Timer callback, drops the session if it went inactive
+  void reclaim_session(const std::string& session_id);
+  void reaper_loop();
 
  public:
   robot_rpc_manager();
@@ -38,7 +68,10 @@ class robot_rpc_manager final : public robot::robot_service::Service {
 
   std::string init_camera_stream(std::function<void()> on_start, std::function<void()> on_server_error,
                                  std::function<void()> on_camera_error, std::function<void()> on_timeout,
-                                 std::function<void()> on_end);
+                                 std::function<void()> on_end, std::function<void(bool greeted)> on_result);
 
   void stop_camera_stream(const std::string& session_id);
+
+  // Camera streams read from this ring instead of the UDP port, must be set before the first stream
+  void set_packet_ring(std::shared_ptr<shm_packet_ring> ring) { packet_ring = std::move(ring); }
 };
\ No newline at end of file
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <grpcpp/grpcpp.h>
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "common/rpc/write_queue.hpp"
+#include "grpc/server.grpc.pb.h"
+
+// Robot side of the trickle ICE signaling stream
+// Descriptions and candidates are queued as the peer connection produces them and written in order,
+// messages from the server are handed to on_message on a gRPC callback thread
+// Keeps itself alive until the call is done, so the owner can drop it at any time after detach()
+
+class signaling_client final : public grpc::ClientBidiReactor<server::signal_message, server::signal_message> {
+ public:
+  using message_callback = std::function<void(const server::signal_message &)>;
+  using done_callback = std::function<void(const grpc::Status &)>;
+
+ private:
+  std::string session_id;
+  grpc::ClientContext context;
+  server::signal_message incoming;
+  write_queue<server::signal_message> outgoing;
+
+  std::mutex callback_mtx;  // held while a callback runs, so detach() returns only once none is running
+  message_callback on_message;
+  done_callback on_done;
+
+  std::shared_ptr<signaling_client> self;  // released in OnDone
+
+  signaling_client(const std::string &sid, message_callback on_message, done_callback on_done);
+
+  void send(server::signal_message message);
+
+ public:
+  static auto start(server::server_service::Stub &stub, const std::string &sid, message_callback on_message,
+                    done_callback on_done) -> std::shared_ptr<signaling_client>;
+
+  void send_description(const std::string &type, const std::string &sdp);
+  void send_candidate(const std::string &candidate, const std::string &mid);
+  void send_end_of_candidates();
+  void send_binding(const std::string &bound_session_id, const std::string &mid, bool bound);
+
+  // Half-closes once the queued messages are written, the server then ends the call
+  void close();
+
+  // Drops the callbacks and cancels the call, no callback runs once this returns
+  void detach();
+
+  void OnReadDone(bool ok) override;
+  void OnWriteDone(bool ok) override;
+  void OnDone(const grpc::Status &status) override;
+};
@@ -1,9 +1,13 @@
 #pragma once
 
 #include <grpcpp/grpcpp.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
 
+#include <array>
 #include <atomic>
 #include <chrono>
+#include <cstring>
 #include <memory>
 #include <rtc/rtc.hpp>
 #include <stdexcept>
@@ -11,8 +15,19 @@
 #include <unordered_set>
 #include <vector>
 
+#include "client/ipc/shm_packet_ring.hpp"
+#include "client/sessions/capture_reactor.hpp"
+#include "client/sessions/keyframe_cache.hpp"
+#include "client/sessions/packet_pool.hpp"
+#include "client/sessions/peer_link.hpp"
+#include "client/sessions/retransmit_history.hpp"
+#include "client/sessions/rtp_rewriter.hpp"
+#include "client/sessions/uplink_worker.hpp"
 #include "common/chat_utils.hpp"
+#include "common/rtp/rtcp_nack.hpp"
 #include "common/sessions/base_session.hpp"
+#include "common/utils/rcu_snapshot.hpp"
+#include "common/utils/timer_wheel.hpp"
 #include "grpc/robot.grpc.pb.h"
 #include "grpc/server.grpc.pb.h"
 
@@ -20,46 +35,70 @@
 
 using namespace std::chrono_literals;
 
-class camera_streamer final : public base_session {
+class camera_streamer final : public base_session, public std::enable_shared_from_this<camera_streamer> {
  private:
+  constexpr static size_t BUFFER_SIZE = 212992;  // max UDP packet size for RTP over IPv4
+  constexpr static size_t PAYLOAD_TYPE = 96;     // must match the payload type of the external h264 RTP stream
+  constexpr static auto START_TIMEOUT = 5s;      // no first packet for a new uplink by then is reported as a timeout
+  constexpr static size_t UPLINK_QUEUE_SIZE = 256;  // per-uplink backlog, ~0.5 s of video at 6 Mbps
+  constexpr static drop_policy UPLINK_DROP_POLICY = drop_policy::DROP_OLDEST;
+  constexpr static size_t HISTORY_SIZE = 512;       // per-uplink packets kept for NACKs, ~0.8 s at 6 Mbps
+  constexpr static size_t PACKET_POOL_SIZE = 2048;  // shared by all uplinks of a capture and their history, ~4 MB
+  constexpr static size_t RECV_BATCH = 32;          // datagrams per recvmmsg, sized for keyframe bursts
+  constexpr static auto STALL_TIMEOUT = 1000ms;     // no packets for this long is reported as a camera error
+
+  // Set once by whichever comes first, the capture's first batch for the uplink or its start timeout
+  enum struct start_state : uint8_t { PENDING, STARTED, TIMED_OUT };
+
   struct uplink {
     std::string session_id;
     std::shared_ptr<rtc::Track> track;
-    std::function<void(std::array<char, 2048>, size_t)> on_data;  // pass by value
+    uint32_t ssrc;                // rewritten on the way out with the track's numbers, the shared packet never is
+    uplink_worker::sink on_data;  // invoked on the uplink's own sender thread
+    std::shared_ptr<retransmit_history> history;  // filled by on_data, read when the receiver sends a NACK
     std::function<void()> on_start;
     std::function<void()> on_camera_error;
     std::function<void()> on_timeout;
+    std::unique_ptr<uplink_worker> worker;  // started once the uplink is attached to a capture
+    bool needs_replay{true};                // cached keyframe not sent yet, capture reactor thread only
+    std::atomic<start_state> start{start_state::PENDING};
 
     uplink() = default;
   };
 
-  struct capture {
-    std::vector<uplink> uplinks;
-    std::thread capture_thread;
-
-    std::condition_variable capture_cv;
-    std::mutex capture_mtx;
-
-    int socket;
-    std::atomic<bool> is_running;
-    std::atomic<bool> has_data;
+  // Preallocated recvmmsg state, only touched by the capture reactor thread
+  struct receive_ring {
+    std::array<packet_ref, RECV_BATCH> slots;
+    std::array<packet_ref, RECV_BATCH> batch;
+    std::array<mmsghdr, RECV_BATCH> msgs;
+    std::array<iovec, RECV_BATCH> iovs;
+    std::array<std::array<char, CMSG_SPACE(sizeof(timespec))>, RECV_BATCH> controls;
+  };
 
-    capture() : socket{-1}, is_running{false}, has_data{false} {}
+  struct capture {
+    std::unique_ptr<packet_pool> pool;  // declared first so it outlives every packet_ref below
+    std::unique_ptr<receive_ring> ring;
+    std::unique_ptr<keyframe_cache> keyframes;  // replayed to late-joining uplinks
+    rcu_snapshot<std::vector<std::shared_ptr<uplink>>> uplinks;  // read lock-free by the capture reactor
+
+    std::string name;  // capture key, "udp:<port>" or "shm:<ring name>"
+    int fd;            // watched by the reactor, UDP socket or the ring's eventfd
+    std::shared_ptr<shm_packet_ring> shm;  // shared memory ingest, UDP when null
+    shm_packet_ring::cursor cursor;
+    size_t dispatching;  // uplinks being attached, not released while any is; captures_mtx
+
+    capture() : fd{-1}, dispatching{0} {}
   };
 
- private:
-  constexpr static size_t BUFFER_SIZE = 212992;  // max UDP packet size for RTP over IPv4
-  constexpr static size_t SSRC = 42;             // arbitrary SSRC for the video track
-  constexpr static size_t PAYLOAD_TYPE = 96;     // must match the payload type of the external h264 RTP stream
-  constexpr static size_t TIMEOUT = 3;           // timeout to stop waiting for uplink to open
-  static std::unordered_map<int, capture> captures;
+  static std::unordered_map<std::string, std::shared_ptr<capture>> captures;
+  static std::mutex captures_mtx;  // protects the map itself, never held while touching uplinks
 
  private:
-  std::shared_ptr<server::server_service::Stub> stub;
-  rtc::Configuration config{};  // customize (STUN/TURN) as needed
-  std::shared_ptr<rtc::PeerConnection> pc;
+  std::shared_ptr<peer_link> link;  // the robot's persistent connection, lends this session a track
 
   int rtp_port;
+  std::shared_ptr<shm_packet_ring> packet_ring;  // preferred over the UDP port when set
+  std::string source;
 
   // Callbacks
   std::function<void()> on_start;
@@ -67,111 +106,106 @@ class camera_streamer final : public base_session {
   std::function<void()> on_end;
   std::function<void()> on_camera_error;
   std::function<void()> on_timeout;
+  std::function<void(bool greeted)> on_result;
 
-  void dispatch_uplink(const uplink &link);
-  void capture_work(int port);
+  bool dispatch_uplink(std::shared_ptr<uplink> link);
+  void detach_uplink(capture &cap);
+  static void send_packet(rtc::Track &track, uint32_t ssrc, const packet_ref &packet,
+                          rtp_rewriter::mapping numbers);
+  static void answer_nacks(const rtc::binary &message, uplink &up);
+
+  // Run on the capture reactor thread
+  static void capture_work(capture &cap);
+  static void shm_capture_work(capture &cap);
+  static void deliver_batch(capture &cap, size_t count);
+  static void capture_stall(capture &cap);
+  static void release_capture(const std::string &source);
 
  public:
   camera_streamer() = delete;
 
-  camera_streamer(const std::string &sid, int rtp_port, std::shared_ptr<server::server_service::Stub> stub)
-      : base_session{sid}, rtp_port{rtp_port}, stub{stub} {}
+  // RTP re-received over UDP loopback from the camera's network stream
+  camera_streamer(const std::string &sid, int rtp_port, std::shared_ptr<peer_link> link)
+      : base_session{sid}, link{link}, rtp_port{rtp_port}, source{"udp:" + std::to_string(rtp_port)} {}
+
+  // RTP published by the camera into a shared memory ring, no socket involved
+  camera_streamer(const std::string &sid, std::shared_ptr<shm_packet_ring> packet_ring, std::shared_ptr<peer_link> link)
+      : base_session{sid},
+        link{link},
+        rtp_port{-1},
+        packet_ring{packet_ring},
+        source{"shm:" + packet_ring->get_name()} {}
 
+  // Must not be destroyed from the capture reactor thread
   ~camera_streamer() override {
-    // Release resources if no more uplinks
-    if (captures[rtp_port].uplinks.empty()) {
-      captures[rtp_port].is_running.store(false);
-      if (captures[rtp_port].capture_thread.joinable()) {
-        captures[rtp_port].capture_thread.join();
-      }
-
-      close(captures[rtp_port].socket);
-      captures.erase(rtp_port);
-      LOG_DEBUG(logger, "Camera stream on port {} destroyed", rtp_port);
-    }
+    link->release_track(session_id);
+    release_capture(source);
   }
 
   void remove_stream() {
     // This only removes the uplink from the capture list and marks the session inactive
     // The real cleanup is done in the destructor, which is called when the session is removed from the session manager
-    // Linear search but should be ok since few uplinks are expected
-    captures[rtp_port].uplinks.erase(
-        std::remove_if(captures[rtp_port].uplinks.begin(), captures[rtp_port].uplinks.end(),
-                       [this](const uplink &u) { return u.session_id == session_id; }),
-        captures[rtp_port].uplinks.end());
+    // Inactive first, an uplink attached concurrently sees it and detaches itself (see dispatch_uplink)
+    deactivate();
+
+    auto cap = std::shared_ptr<capture>{};
+    {
+      std::lock_guard<std::mutex> lock(captures_mtx);
+      auto it = captures.find(source);
+      if (it != captures.end()) cap = it->second;
+    }
+    if (cap) detach_uplink(*cap);
 
-    session_active.store(false);
+    // The track stays negotiated and goes back to the link's pool for the next session
+    link->release_track(session_id);
     LOG_DEBUG(logger, "Camera stream for session {} marked inactive", session_id);
   }
 
   void create_stream() {
-    pc = std::make_shared<rtc::PeerConnection>(config);
-
-    auto media = rtc::Description::Video("video", rtc::Description::Direction::SendOnly);
-    media.addH264Codec(96);  // Must match the payload type of the external h264 RTP stream
-    media.addSSRC(SSRC, "video-send");
-    auto track = pc->addTrack(media);
-
-    // Set up peer connection event handlers
-    pc->onGatheringStateChange([this](rtc::PeerConnection::GatheringState state) {
-      // Only proceed when ICE gathering is complete
-      if (state == rtc::PeerConnection::GatheringState::Complete) {
-        auto offer = pc->localDescription();
-
-        if (!offer) {
-          LOG_ERROR(logger, "No local description available at ICE gathering complete stage");
-          on_server_error();
-          return;  // Cannot proceed without SDP
-        }
-
-        // Send the offer to the signaling server and wait for the answer
-        grpc::ClientContext context;  // Must be non-null
-        auto request = std::make_shared<server::init_camera_offer>();
-        auto response = std::make_shared<server::init_camera_answer>();
-
-        request->set_session_id(session_id);
-        request->set_sdp(std::string{offer.value()});
-
-        auto status = stub->init_camera_stream(&context, *request, response.get());
-
-        if (status.ok()) {
-          try {
-            pc->setRemoteDescription(response->sdp());
-          } catch (const std::exception &e) {
-            LOG_ERROR(logger, "Failed to set remote description: {}", e.what());
-            on_server_error();
-          }
-        } else {
-          LOG_ERROR(logger, "Error {}, {}", static_cast<int>(status.error_code()), status.error_message());
-          on_server_error();
-        }
-      }
-    });
-
-    pc->onStateChange([this, track](rtc::PeerConnection::State state) -> void {
-      if (state == rtc::PeerConnection::State::Connected) {
-        // Start streaming
-        auto link = uplink{.session_id = session_id,
-                           .track = track,
-                           .on_data =
-                               [this, track](std::array<char, 2048> buffer, size_t len) {
-                                 auto rtp = reinterpret_cast<rtc::RtpHeader *>(buffer.data());
-                                 rtp->setSsrc(SSRC);
-                                 track->send(reinterpret_cast<const std::byte *>(buffer.data()), len);
-                               },
-                           .on_start = on_start,
-                           .on_camera_error = on_camera_error,
-                           .on_timeout = on_timeout};
-        dispatch_uplink(link);
-      } else if (state == rtc::PeerConnection::State::Disconnected) {
-        // Error
-        on_server_error();
-      } else if (state == rtc::PeerConnection::State::Closed) {
-        // Terminated by server (finished)
-      }
-    });
-
-    pc->setLocalDescription(rtc::Description::Type::Offer);
+    // Borrow a track of the robot's persistent connection, an idle pooled track is already open
+    // Weak, the link may open the track after this session was removed and reclaimed
+    link->acquire_track(
+        session_id,
+        [weak = weak_from_this()](std::shared_ptr<rtc::Track> track, uint32_t ssrc,
+                                  std::shared_ptr<rtp_rewriter> rewriter) {
+          auto self = weak.lock();
+          if (!self || !self->is_active()) return;  // removed before its track opened
+
+          // Start streaming, the pooled track may have carried another session: continue its numbering
+          rewriter->restart();
+          auto up = std::make_shared<uplink>();
+          up->session_id = self->session_id;
+          up->track = track;
+          up->ssrc = ssrc;
+          up->history = std::make_shared<retransmit_history>(HISTORY_SIZE);
+          up->on_data = [track, ssrc, rewriter, history = up->history](const packet_ref &packet) {
+            auto header = reinterpret_cast<const rtc::RtpHeader *>(packet.data());
+            auto numbers = rewriter->map(header->seqNumber(), header->timestamp());
+            send_packet(*track, ssrc, packet, numbers);
+            history->store(packet, numbers.seq, numbers.timestamp);
+          };
+
+          up->on_start = self->on_start;
+          up->on_camera_error = self->on_camera_error;
+          up->on_timeout = self->on_timeout;
+          if (!self->dispatch_uplink(up)) return;
+
+          // Only RTCP comes back on a send-only track; weak since a pooled track outlives the session
+          track->onMessage(
+              [weak = std::weak_ptr<uplink>(up)](rtc::binary message) {
+                if (auto up = weak.lock()) answer_nacks(message, *up);
+              },
+              nullptr);
+        },
+        [weak = weak_from_this()]() {
+          // The link failed while this session held a track
+          if (auto self = weak.lock()) self->on_server_error();
+        },
+        [weak = weak_from_this()](bool greeted) {
+          // The server recognized a face on this session's stream
+          auto self = weak.lock();
+          if (self && self->on_result) self->on_result(greeted);
+        });
   }
 
   void set_on_start(std::function<void()> callback) { on_start = std::move(callback); }
@@ -179,4 +213,5 @@ class camera_streamer final : public base_session {
   void set_on_end(std::function<void()> callback) { on_end = std::move(callback); }
   void set_on_camera_error(std::function<void()> callback) { on_camera_error = std::move(callback); }
   void set_on_timeout(std::function<void()> callback) { on_timeout = std::move(callback); }
+  void set_on_result(std::function<void(bool greeted)> callback) { on_result = std::move(callback); }
 };
\ No newline at end of file
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+// Single epoll thread multiplexing every capture socket of the process
+// Thread count stays flat as ports are added, and a quiet source costs no wakeups at all:
+// the reactor only wakes up for readable sockets or for the earliest armed stall deadline
+
+class capture_reactor {
+ public:
+  using on_readable_fn = std::function<void()>;
+  using on_stall_fn = std::function<void()>;
+
+ private:
+  struct source {
+    int fd;
+    on_readable_fn on_readable;
+    on_stall_fn on_stall;
+    std::chrono::steady_clock::time_point stall_deadline;  // time_point::max() when disarmed
+  };
+
+  int epoll_fd;
+  int wake_fd;  // eventfd, used to stop the loop and to pick up new stall deadlines
+
+  std::unordered_map<int, std::shared_ptr<source>> sources;
+  std::mutex mtx;  // protects sources and dispatching
+  std::condition_variable dispatch_cv;
+  int dispatching_fd;  // fd whose callback is currently running on the reactor thread, -1 if none
+
+  std::thread reactor_thread;
+  std::atomic<bool> is_running;
+
+  capture_reactor();
+  ~capture_reactor();
+
+  void reactor_work();
+  void wake();
+  int next_timeout_ms();
+  void fire_stalls();
+
+ public:
+  capture_reactor(const capture_reactor &) = delete;
+  capture_reactor &operator=(const capture_reactor &) = delete;
+
+  static auto get_instance() -> capture_reactor & {
+    static capture_reactor instance;
+    return instance;
+  }
+
+  // Registers a non-blocking socket, on_readable runs on the reactor thread (edge triggered, drain until EAGAIN)
+  void add(int fd, on_readable_fn on_readable, on_stall_fn on_stall);
+
+  // Once this returns no callback for fd is running or will run, unless called from the reactor thread itself
+  void remove(int fd);
+
+  // One-shot stall timer, on_stall fires if the source is not re-armed or disarmed before the timeout
+  // Re-arming only touches the deadline, the reactor is woken up only when the deadline moves earlier
+  void arm_stall(int fd, std::chrono::milliseconds timeout);
+  void disarm_stall(int fd);
+
+  bool in_reactor_thread() const { return std::this_thread::get_id() == reactor_thread.get_id(); }
+};
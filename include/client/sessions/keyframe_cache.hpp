@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "client/sessions/packet_pool.hpp"
+#include "client/sessions/uplink_worker.hpp"
+
+// Keeps the most recent SPS/PPS and the packets of the most recent complete IDR access unit
+// A newly attached uplink gets these replayed before live packets, so its decoder can start right away
+// instead of waiting up to a whole GOP for the next IDR
+// Not thread safe, observe() and replay() both run on the capture reactor thread
+
+class keyframe_cache {
+ private:
+  constexpr static size_t MAX_PARAM_PACKETS = 4;   // SPS + PPS, possibly repeated or aggregated
+  constexpr static size_t MAX_IDR_PACKETS = 256;   // ~300 KB keyframe at 1200 byte payloads
+
+  uint8_t payload_type;
+
+  std::vector<packet_ref> params;     // latest parameter set packets
+  uint32_t params_timestamp;
+
+  std::vector<packet_ref> building;   // IDR access unit being collected
+  uint32_t building_timestamp;
+  bool is_building;
+
+  std::vector<packet_ref> keyframe;   // last complete IDR access unit, parameter sets first
+  size_t overflows;
+
+ public:
+  explicit keyframe_cache(uint8_t payload_type);
+
+  // Called for every captured packet, allocation-free after construction
+  void observe(const packet_ref &packet);
+
+  // Pushes the cached keyframe into the worker, returns false if no complete keyframe is cached yet
+  bool replay(uplink_worker &worker) const;
+
+  bool has_keyframe() const { return !keyframe.empty(); }
+  size_t get_overflows() const { return overflows; }
+};
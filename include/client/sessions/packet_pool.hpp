@@ -0,0 +1,96 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Fixed pool of refcounted RTP packet buffers
+// The capture thread fills a packet once and every uplink shares it through a cheap packet_ref handle,
+// the buffer returns to the pool when the last handle goes away
+
+class packet_pool;
+
+struct rtp_packet {
+  constexpr static size_t MAX_SIZE = 2048;
+
+  std::array<char, MAX_SIZE> data;
+  size_t len;
+  int64_t rx_time_ns;  // kernel receive timestamp (CLOCK_REALTIME), 0 if unavailable
+
+ private:
+  friend class packet_pool;
+  friend class packet_ref;
+
+  std::atomic<uint32_t> refs{0};
+  packet_pool *pool{nullptr};
+};
+
+class packet_ref {
+ private:
+  rtp_packet *packet;
+
+  void release();
+
+ public:
+  packet_ref() : packet{nullptr} {}
+  explicit packet_ref(rtp_packet *p) : packet{p} {
+    if (packet) packet->refs.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  packet_ref(const packet_ref &other) : packet_ref{other.packet} {}
+  packet_ref(packet_ref &&other) noexcept : packet{other.packet} { other.packet = nullptr; }
+
+  packet_ref &operator=(const packet_ref &other) {
+    if (this != &other) {
+      release();
+      packet = other.packet;
+      if (packet) packet->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+    return *this;
+  }
+
+  packet_ref &operator=(packet_ref &&other) noexcept {
+    if (this != &other) {
+      release();
+      packet = other.packet;
+      other.packet = nullptr;
+    }
+    return *this;
+  }
+
+  ~packet_ref() { release(); }
+
+  explicit operator bool() const { return packet != nullptr; }
+  const char *data() const { return packet->data.data(); }
+  size_t size() const { return packet->len; }
+  int64_t rx_time_ns() const { return packet->rx_time_ns; }
+
+  // Only valid while the capture thread is the sole owner, i.e. before the packet is shared
+  rtp_packet *get() const { return packet; }
+};
+
+class packet_pool {
+ private:
+  std::vector<rtp_packet> slots;  // allocated once, never resized
+  std::vector<rtp_packet *> free_list;
+  std::mutex mtx;  // protects free_list, packets are released from the uplink sender threads
+  std::atomic<size_t> exhausted;
+
+  friend class packet_ref;
+  void release(rtp_packet *packet);
+
+ public:
+  packet_pool() = delete;
+  packet_pool(const packet_pool &) = delete;
+  packet_pool &operator=(const packet_pool &) = delete;
+
+  explicit packet_pool(size_t capacity);
+
+  // Returns an empty handle when every slot is in flight
+  packet_ref acquire();
+
+  size_t get_exhausted() const { return exhausted.load(std::memory_order_relaxed); }
+};
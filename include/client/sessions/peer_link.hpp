@@ -0,0 +1,91 @@
+#pragma once
+
+#include <grpcpp/grpcpp.h>
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <rtc/rtc.hpp>
+#include <string>
+#include <vector>
+
+#include "client/rpc/signaling_client.hpp"
+#include "client/sessions/rtp_rewriter.hpp"
+#include "grpc/server.grpc.pb.h"
+
+// Long-lived peer connection between this robot and the server, shared by every camera session
+//
+// The connection is opened with a pool of send-only video tracks that are negotiated up front. A session
+// borrows an idle track and announces the binding over the signaling stream, so starting a session costs a
+// signaling message instead of a new ICE + DTLS handshake. When every track is taken, a track is added and
+// the connection renegotiated; released tracks go back to the pool and are never removed
+// A failed connection fails its bound sessions and is reopened by the next acquire_track()
+// Owned by a shared_ptr, connection and signaling callbacks hold it weakly
+
+class peer_link final : public std::enable_shared_from_this<peer_link> {
+ public:
+  // Invoked once the borrowed track is open, from a libdatachannel thread or the caller's thread; packets go out
+  // with the rewriter's numbers, it belongs to the track and carries its numbering from session to session
+  // Runs outside the link's lock and must not block, the session may have been released meanwhile
+  using track_ready =
+      std::function<void(std::shared_ptr<rtc::Track> track, uint32_t ssrc, std::shared_ptr<rtp_rewriter> rewriter)>;
+
+  // Recognition outcome the server sent for the session, from a gRPC callback thread
+  using result_callback = std::function<void(bool greeted)>;
+
+ private:
+  constexpr static size_t TRACK_POOL_SIZE = 4;  // concurrent sessions served without renegotiation
+  constexpr static uint8_t PAYLOAD_TYPE = 96;   // must match the payload type of the external h264 RTP stream
+  constexpr static uint32_t BASE_SSRC = 42;     // track n sends with BASE_SSRC + n
+
+  enum struct link_state { CLOSED, CONNECTING, CONNECTED, FAILED };
+
+  struct track_slot {
+    std::string mid;
+    uint32_t ssrc;
+    std::shared_ptr<rtc::Track> track;
+    std::shared_ptr<rtp_rewriter> rewriter;
+
+    std::string session_id;  // empty while the track is idle in the pool
+    track_ready on_ready;    // pending until the track opens
+    std::function<void()> on_error;
+    result_callback on_result;
+  };
+
+  std::shared_ptr<server::server_service::Stub> stub;
+  std::string link_id;
+  rtc::Configuration config{};  // customize (STUN/TURN) as needed
+
+  std::mutex mtx;  // protects everything below, offers are created outside of it
+  link_state state;
+  uint64_t generation;       // bumped per connection, callbacks of a replaced connection are ignored
+  bool needs_renegotiation;  // a track was added while an offer was outstanding
+  std::shared_ptr<rtc::PeerConnection> pc;
+  std::shared_ptr<signaling_client> signaling;
+  std::vector<std::unique_ptr<track_slot>> slots;  // stable addresses for the track callbacks
+
+  // mtx held, the caller sends the first offer after unlocking
+  void open();
+  auto add_track() -> track_slot &;
+
+  void renegotiate(uint64_t gen);
+  void fail(uint64_t gen, const std::string &reason);
+  void on_track_open(uint64_t gen, size_t index);
+  void on_recognition(const std::string &session_id, bool greeted);
+
+ public:
+  peer_link(const std::string &link_id, std::shared_ptr<server::server_service::Stub> stub);
+  ~peer_link();
+
+  peer_link(const peer_link &) = delete;
+  peer_link &operator=(const peer_link &) = delete;
+
+  // Binds an idle track to the session, on_error fires if the link fails while the session holds the track
+  void acquire_track(const std::string &session_id, track_ready on_ready, std::function<void()> on_error,
+                     result_callback on_result = nullptr);
+
+  // Unbinds the session's track and returns it to the pool, no-op if the session holds none
+  void release_track(const std::string &session_id);
+
+  const std::string &get_id() const { return link_id; }
+};
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "client/sessions/packet_pool.hpp"
+
+// Recently sent packets of one uplink, indexed by RTP sequence number, to answer NACKs from the receiver
+// Entries are handles into the capture's packet pool, so keeping history copies nothing, it only holds buffers
+// back from being recycled; the ring is sized once and never grows
+// A NACK for a packet that already left the ring is ignored, the receiver falls back to a keyframe request
+
+class retransmit_history {
+ private:
+  constexpr static int64_t RESEND_INTERVAL_NS = 4'000'000;  // below the receiver's re-NACK floor, drops repeats
+
+  struct entry {
+    packet_ref packet;
+    uint16_t seq{0};        // as sent on the track, which is what NACKs name
+    uint32_t timestamp{0};  // as sent, a resend must match it
+    int64_t resent_ns{0};
+  };
+
+  std::vector<entry> entries;  // power of two, indexed by seq
+  size_t mask;
+  std::mutex mtx;  // store() runs on the uplink's sender thread, find() on a libdatachannel thread
+
+  std::atomic<size_t> resent;
+  std::atomic<size_t> missed;
+
+ public:
+  retransmit_history() = delete;
+  retransmit_history(const retransmit_history &) = delete;
+  retransmit_history &operator=(const retransmit_history &) = delete;
+
+  // capacity is rounded up to a power of two
+  explicit retransmit_history(size_t capacity);
+
+  // Remembers a packet right after it was sent with this sequence number and timestamp
+  void store(const packet_ref &packet, uint16_t seq, uint32_t timestamp);
+
+  // The sent packet with this sequence number and its timestamp, empty if it is gone or was resent within
+  // RESEND_INTERVAL_NS
+  packet_ref find(uint16_t seq, int64_t now_ns, uint32_t &timestamp);
+
+  size_t get_resent() const { return resent.load(std::memory_order_relaxed); }
+  size_t get_missed() const { return missed.load(std::memory_order_relaxed); }
+};
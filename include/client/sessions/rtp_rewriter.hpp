@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+
+// Maps the capture's RTP sequence numbers and timestamps onto the sequence space of one pooled track
+//
+// Every uplink sends the camera's own numbers, so a track lent to a new session, or fed a cached keyframe, would
+// repeat numbers it already sent or run backwards: SRTP replay protection drops those packets and the receiver's
+// depacketizer takes them for late ones. Within a run the mapping is a fixed offset, so real losses stay gaps the
+// receiver can NACK; restart() or a jump forward of more than MAX_GAP starts a new run right after the last number
+// sent on the track
+// One per pooled track, outliving the sessions that borrow it; the lock only contends while the worker of a
+// released session drains next to its successor
+
+class rtp_rewriter {
+ public:
+  struct mapping {
+    uint16_t seq;
+    uint32_t timestamp;
+  };
+
+ private:
+  constexpr static uint16_t MAX_GAP = 64;           // a longer forward jump is a new source run, not a loss
+  constexpr static uint32_t TIMESTAMP_STEP = 3000;  // between runs, one frame at 30 fps of the 90 kHz clock
+
+  std::mutex mtx;
+  bool started;     // anything sent on the track yet
+  bool rebase;      // the next packet starts a new run
+  uint16_t last_in_seq;
+  uint16_t seq_offset;
+  uint32_t ts_offset;
+  uint16_t last_out_seq;  // highest sent, wrap-aware
+  uint32_t last_out_ts;
+
+ public:
+  rtp_rewriter();
+
+  rtp_rewriter(const rtp_rewriter &) = delete;
+  rtp_rewriter &operator=(const rtp_rewriter &) = delete;
+
+  // A new session starts on the track, its first packet (usually a replayed keyframe) follows the last one sent
+  void restart();
+
+  // Numbers to send the capture's packet with
+  mapping map(uint16_t seq, uint32_t timestamp);
+};
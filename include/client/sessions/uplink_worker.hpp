@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "client/sessions/packet_pool.hpp"
+
+// Long-lived sender thread for a single uplink, fed by the capture thread through a bounded queue
+// A slow peer only fills its own queue, it never blocks the capture thread or the other uplinks
+
+enum struct drop_policy {
+  DROP_OLDEST,  // evict the oldest queued packet to make room (lowest latency)
+  DROP_NEWEST   // reject the incoming packet when the queue is full
+};
+
+class uplink_worker {
+ public:
+  using sink = std::function<void(const packet_ref &)>;  // packet is shared with other uplinks, read-only
+
+ private:
+  std::vector<packet_ref> queue;  // preallocated ring of handles, never resized after construction
+  size_t head;
+  size_t count;
+  drop_policy policy;
+
+  std::mutex mtx;
+  std::condition_variable cv;
+  std::thread sender_thread;
+  std::atomic<bool> is_running;
+  std::atomic<size_t> dropped;
+
+  sink on_send;
+
+  void send_work();
+
+ public:
+  uplink_worker() = delete;
+  uplink_worker(const uplink_worker &) = delete;
+  uplink_worker &operator=(const uplink_worker &) = delete;
+
+  uplink_worker(size_t capacity, drop_policy policy, sink on_send);
+  ~uplink_worker();
+
+  // Called from the capture thread, never blocks on the peer
+  // Returns false if a packet had to be dropped
+  bool push(const packet_ref &packet);
+
+  // Enqueues a whole receive batch under one lock and one wakeup
+  // Returns the number of packets accepted without dropping
+  size_t push(const packet_ref *packets, size_t size);
+
+  void stop();
+  size_t get_dropped() const { return dropped.load(std::memory_order_relaxed); }
+};
@@ -1,19 +1,59 @@
 #pragma once
 
+#include <grpcpp/grpcpp.h>
+
 #include <memory>
 
 #include "client_states.hpp"
+#include "event_dispatcher.hpp"
 
 // All calls to state transitions should be made through this manager
 class client_state_manager {
  private:
+  constexpr static auto PACKET_RING_NAME = "/chat_engine_camera";
+  constexpr static uint32_t PACKET_RING_SLOTS = 4096;  // ~1.5 s of 6 Mbps video
+  constexpr static uint32_t PACKET_RING_SLOT_SIZE = 1500;
+  constexpr static size_t DISPATCHER_THREADS = 1;  // one robot in this process, its events run in order anyway
+  constexpr static auto LISTEN_ADDRESS = "0.0.0.0:6002";  // robot_service, where the server's registry looks
+  constexpr static int MIN_PING_INTERVAL_MS = 10'000;     // below the server's 20 s keepalive, pings are not strikes
+
+  std::shared_ptr<shm_packet_ring> packet_ring;
   std::shared_ptr<generic_camera> camera;
   std::shared_ptr<robot_rpc_manager> rpc_manager;
+  std::shared_ptr<event_dispatcher> dispatcher;  // runs every transition
+  std::shared_ptr<bot_context> robot;            // this robot's FSM, from start()
+  std::unique_ptr<grpc::Server> rpc_server;      // serves rpc_manager to the chat server
 
   client_state_manager()
-      : camera{std::make_shared<laptop_camera>()}, rpc_manager{std::make_shared<robot_rpc_manager>()} {
-    bot::camera = camera;
-    bot::rpc_manager = rpc_manager;
+      : packet_ring{make_packet_ring()},
+        camera{std::make_shared<laptop_camera>()},
+        rpc_manager{std::make_shared<robot_rpc_manager>()},
+        dispatcher{std::make_shared<event_dispatcher>(DISPATCHER_THREADS)} {
+    // Camera and streamer share the ring, RTP never goes through the loopback interface
+    if (packet_ring) {
+      camera->set_packet_ring(packet_ring);
+      rpc_manager->set_packet_ring(packet_ring);
+    }
+
+    // The server holds a warm channel here with keepalive pings while no call is running, the gRPC defaults
+    // would answer them with a too_many_pings GOAWAY and drop that channel
+    grpc::ServerBuilder builder;
+    builder.AddListeningPort(LISTEN_ADDRESS, grpc::InsecureServerCredentials());
+    builder.AddChannelArgument(GRPC_ARG_KEEPALIVE_PERMIT_WITHOUT_CALLS, 1);
+    builder.AddChannelArgument(GRPC_ARG_HTTP2_MIN_RECV_PING_INTERVAL_WITHOUT_DATA_MS, MIN_PING_INTERVAL_MS);
+    builder.RegisterService(rpc_manager.get());
+    rpc_server = builder.BuildAndStart();
+    if (!rpc_server) LOG_ERROR(logger, "Failed to listen on {}, the server cannot reach this robot", LISTEN_ADDRESS);
+  }
+
+  // nullptr when shared memory is unavailable, the camera then streams RTP over the UDP port
+  static auto make_packet_ring() -> std::shared_ptr<shm_packet_ring> {
+    try {
+      return shm_packet_ring::create(PACKET_RING_NAME, PACKET_RING_SLOTS, PACKET_RING_SLOT_SIZE);
+    } catch (const std::exception& e) {
+      LOG_WARNING(logger, "Shared memory packet ring unavailable, falling back to UDP: {}", e.what());
+      return nullptr;
+    }
   }
 
   ~client_state_manager();
@@ -24,5 +64,8 @@ class client_state_manager {
     return instance;
   }
 
-  auto start() -> void { bot::start(); }
+  // The initial state is entered on a dispatcher worker like every later transition
+  auto start() -> void {
+    if (!robot) robot = dispatcher->create(camera, rpc_manager);
+  }
 };
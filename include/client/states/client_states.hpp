@@ -257,11 +257,16 @@ struct stream_speech_failure_event;
 struct stream_response_success_event;
 struct stream_response_failure_event;
 
+/* Any of the above, queued by the dispatcher*/
+struct bot_event;
+
 //=============================================================================
 // STATE MACHINE DECLARATIONS
 //=============================================================================
 
 struct bot;
+class bot_context;
+class event_dispatcher;
 
 //=============================================================================
 // STATE MACHINE DEFINITIONS
@@ -275,6 +280,12 @@ struct bot;
 
 #include "impl/event_impl.hpp"
 
+//=============================================================================
+// STATE MACHINE INSTANCES
+//=============================================================================
+
+#include "impl/context_impl.hpp"
+
 //=============================================================================
 // STATE DEFINITIONS
 //=============================================================================
@@ -293,5 +304,7 @@ struct bot;
 #include "impl/wait_stream_speech_state_impl.hpp"
 
 //=============================================================================
-// INITIAL STATE - defined in client_states.cpp
-//=============================================================================
\ No newline at end of file
+// TRANSITION TABLE
+//=============================================================================
+
+#include "impl/transitions_impl.hpp"
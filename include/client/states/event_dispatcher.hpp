@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "client/states/client_states.hpp"
+
+// Worker pool that runs the bot FSM of every robot in the process
+//
+// Camera, libdatachannel and gRPC threads only post() into a robot's lock-free mailbox, they never wait on a
+// transition or on each other. A robot with mail is queued once (its scheduled flag) and run by one worker at a time,
+// which drains up to BATCH events and requeues it if more arrived, so its events stay in order while other robots run
+// on the other workers. A slow entry() delays that robot only
+// A full mailbox drops the event and counts it, producers never block
+
+class event_dispatcher {
+ public:
+  struct stats {
+    uint64_t posted;
+    uint64_t dropped;  // mailbox full
+    uint64_t dispatched;
+    uint64_t depth;  // queued right now, all robots
+    uint64_t max_depth;
+    int64_t mean_latency_us;  // post to start of dispatch, exponential average
+    int64_t max_latency_us;
+  };
+
+ private:
+  constexpr static size_t BATCH = 16;  // events per turn of a robot, then it goes to the back of the run queue
+  constexpr static int64_t LATENCY_WARNING_US = 100'000;  // a state is stuck in entry() or react()
+
+  std::mutex mtx;
+  std::condition_variable ready_cv;
+  std::deque<std::shared_ptr<bot_context>> ready;  // robots with mail, each at most once
+  bool stopping;
+  std::vector<std::thread> workers;
+
+  std::atomic<uint64_t> posted;
+  std::atomic<uint64_t> dropped;
+  std::atomic<uint64_t> dispatched;
+  std::atomic<uint64_t> max_depth;
+  std::atomic<int64_t> mean_latency_us;
+  std::atomic<int64_t> max_latency_us;
+
+  void schedule(std::shared_ptr<bot_context> robot);
+  void worker_loop();
+  void run(bot_context &robot);
+  void record_latency(const bot_event &event, int64_t latency_us);
+
+  // 1 absent or 2 present for a human_presence_event, 0 for any other event
+  static uint8_t presence_of(const bot_event &event);
+
+  friend class bot_context;
+  bool post(bot_context &robot, const bot_event &event);
+
+ public:
+  explicit event_dispatcher(size_t threads = std::thread::hardware_concurrency());
+  ~event_dispatcher();
+
+  event_dispatcher(const event_dispatcher &) = delete;
+  event_dispatcher &operator=(const event_dispatcher &) = delete;
+
+  // A new robot, its initial state is entered on a worker; it lives as long as the returned pointer or its mail
+  std::shared_ptr<bot_context> create(std::shared_ptr<generic_camera> camera,
+                                      std::shared_ptr<robot_rpc_manager> rpc_manager);
+
+  size_t get_threads() const { return workers.size(); }
+  stats get_stats() const;
+};
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <client/states/client_states.hpp>
+
+#include "common/utils/mpsc_queue.hpp"
+#include "common/utils/timer_wheel.hpp"
+
+//=============================================================================
+// STATE MACHINE INSTANCES
+//=============================================================================
+
+// One robot: its current state, what its states work with, and its mailbox
+//
+// The state structs are stateless singletons shared by every robot, everything a robot owns lives here so a process
+// can host thousands of them. A context is run by one dispatcher worker at a time: post() is the only member other
+// threads touch, the rest belongs to whichever worker holds the scheduled flag
+class bot_context : public std::enable_shared_from_this<bot_context> {
+ public:
+  constexpr static size_t MAILBOX_CAPACITY = 256;  // a slow entry() must not cost server_ready or timeout events
+
+  std::shared_ptr<generic_camera> camera;
+  std::shared_ptr<robot_rpc_manager> rpc_manager;
+  std::string current_sid;  // camera stream session of wait_stream_camera_state, empty when none
+
+ private:
+  struct queued_event {
+    bot_event event;
+    int64_t posted_ns;  // steady clock
+  };
+
+  event_dispatcher &dispatcher;
+  std::atomic<uint8_t> state;  // index in bot_states, NONE until started; read by get_state() from anywhere
+  mpsc_queue<queued_event> mailbox;
+  std::atomic<bool> scheduled;  // queued on or run by a dispatcher worker
+  std::atomic<uint32_t> pending;  // events pushed and not popped yet, what the worker re-checks after a turn
+
+  // Presence is reported at detection rate, a report equal to the one still queued is dropped: 0 none queued,
+  // 1 absent, 2 present
+  std::atomic<uint8_t> queued_presence;
+
+  // Deadline of the current state, see has_deadline; a timeout_event of an older deadline is stale and dropped
+  std::shared_ptr<timer_wheel> timers;
+  timer_wheel::timer_id deadline_timer;  // 0 when the state has no deadline
+  uint32_t deadline;                     // sequence number of the last deadline armed, never 0 once armed
+
+  friend class event_dispatcher;
+  friend struct bot;
+
+ public:
+  bot_context(event_dispatcher &dispatcher, std::shared_ptr<generic_camera> camera,
+              std::shared_ptr<robot_rpc_manager> rpc_manager);
+
+  ~bot_context();
+
+  bot_context(const bot_context &) = delete;
+  bot_context &operator=(const bot_context &) = delete;
+
+  // Any thread, never blocks; false if the mailbox is full and the event was dropped
+  bool post(const bot_event &event);
+
+  // Any thread, may be one transition behind; for logs and monitoring
+  client_state get_state() const;
+};
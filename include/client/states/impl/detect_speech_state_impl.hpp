@@ -4,28 +4,22 @@
 #include <quill/Logger.h>
 
 #include <client/states/client_states.hpp>
-#include <tinyfsm/tinyfsm.hpp>
 
 //=============================================================================
 // STATE DEFINITIONS
 //=============================================================================
 
 struct detect_speech_state final : bot {
-  auto react(const user_speech_detected_event& e) -> void override {
-    transit<wait_stream_speech_state>(
-        [&e]() -> void {
-          // Action function
-          LOG_INFO(logger, "[detect_speech::react] Speech detected, transitioning to wait_stream_speech_state");
-        },
-        [&e]() -> bool { return e.detected; });
-  }
+  constexpr static client_state ID = client_state::DETECT_SPEECH;
+  constexpr static auto DEADLINE = 10s;  // silence before going back to idle
+
+  static auto detected(const user_speech_detected_event& e) -> bool { return e.detected; }
 
-  auto react(const timeout_event& e) -> void override {
-    transit<idle_state>([&e]() -> void {
-      // Action function
-      LOG_INFO(logger, "[detect_speech::react] Timeout occurred, transitioning to idle_state");
-    });
+  static auto on_speech(const user_speech_detected_event&) -> void {
+    LOG_INFO(logger, "[detect_speech::react] Speech detected, transitioning to wait_stream_speech_state");
   }
 
-  auto get_state() const -> client_state override { return client_state::DETECT_SPEECH; }
-};
\ No newline at end of file
+  static auto on_timeout(const timeout_event&) -> void {
+    LOG_INFO(logger, "[detect_speech::react] Timeout occurred, transitioning to idle_state");
+  }
+};
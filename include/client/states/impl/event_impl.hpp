@@ -1,56 +1,67 @@
 #pragma once
 
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
 #include <client/states/client_states.hpp>
+#include <client/states/transition_table.hpp>
 #include <tinyfsm/tinyfsm.hpp>
 
 //=============================================================================
 // EVENT DEFINITIONS
 //=============================================================================
 
+// Events are plain data: NAME is a compile-time constant of the type, not a member, so an event is trivially
+// copyable and firing one never allocates
+
 /* Non-state specific events*/
 struct generic_event : tinyfsm::Event {
-  std::string name = "generic_event";
+  constexpr static const char *NAME = "generic_event";
 };
 
 struct timeout_event : tinyfsm::Event {
-  std::string name = "timeout_event";
+  constexpr static const char *NAME = "timeout_event";
+  uint32_t deadline;  // state deadline that expired, 0 when posted by anything else
+  timeout_event(uint32_t d) : deadline{d} {}
+  timeout_event() : deadline{0} {}
 };
 
 struct network_error_event : tinyfsm::Event {
-  std::string name = "network_error_event";
+  constexpr static const char *NAME = "network_error_event";
 };
 
 struct playback_error_event : tinyfsm::Event {
-  std::string name = "playback_error_event";
+  constexpr static const char *NAME = "playback_error_event";
 };
 
 struct server_ready_event : tinyfsm::Event {
-  std::string name = "server_ready_event";
+  constexpr static const char *NAME = "server_ready_event";
   bool ready;
   server_ready_event(bool r) : ready{r} {}
   server_ready_event() : ready{true} {}
 };
 
 struct reset_event : tinyfsm::Event {
-  std::string name = "reset_event";
+  constexpr static const char *NAME = "reset_event";
 };
 
-struct terminated_event : tinyfsm::Event {
-  std::string name = "terminated_event";
+struct terminate_event : tinyfsm::Event {
+  constexpr static const char *NAME = "terminate_event";
 };
 
 /* Initial state events*/
 struct init_success_event : tinyfsm::Event {
-  std::string name = "init_success_event";
+  constexpr static const char *NAME = "init_success_event";
 };
 
 struct camera_error_event : tinyfsm::Event {
-  std::string name = "camera_error_event";
+  constexpr static const char *NAME = "camera_error_event";
 };
 
 /* Idle state events*/
 struct human_presence_event : tinyfsm::Event {
-  std::string name = "human_presence_event";
+  constexpr static const char *NAME = "human_presence_event";
   bool present;
   human_presence_event(bool p) : present{p} {}
   human_presence_event() : present{true} {}
@@ -58,7 +69,7 @@ struct human_presence_event : tinyfsm::Event {
 
 /* Stream events*/
 struct facial_recognition_response_event : tinyfsm::Event {
-  std::string name = "facial_recognition_response_event";
+  constexpr static const char *NAME = "facial_recognition_response_event";
   bool greeted;  // Indicates if the user was greeted
   facial_recognition_response_event(bool g) : greeted{g} {}
   facial_recognition_response_event() : greeted{false} {}
@@ -66,16 +77,16 @@ struct facial_recognition_response_event : tinyfsm::Event {
 
 /* Greeting events*/
 struct greeting_success_event : tinyfsm::Event {
-  std::string name = "greeting_success_event";
+  constexpr static const char *NAME = "greeting_success_event";
 };
 
 struct greeting_failure_event : tinyfsm::Event {
-  std::string name = "greeting_failure_event";
+  constexpr static const char *NAME = "greeting_failure_event";
 };
 
 /* Detect speech events*/
 struct user_speech_detected_event : tinyfsm::Event {
-  std::string name = "user_speech_detected_event";
+  constexpr static const char *NAME = "user_speech_detected_event";
   bool detected;
   user_speech_detected_event(bool d) : detected{d} {}
   user_speech_detected_event() : detected{true} {}
@@ -83,18 +94,49 @@ struct user_speech_detected_event : tinyfsm::Event {
 
 /* Stream speech events*/
 struct stream_speech_success_event : tinyfsm::Event {
-  std::string name = "stream_speech_success_event";
+  constexpr static const char *NAME = "stream_speech_success_event";
 };
 
 struct stream_speech_failure_event : tinyfsm::Event {
-  std::string name = "stream_speech_failure_event";
+  constexpr static const char *NAME = "stream_speech_failure_event";
 };
 
 /* Stream response events*/
 struct stream_response_success_event : tinyfsm::Event {
-  std::string name = "stream_response_success_event";
+  constexpr static const char *NAME = "stream_response_success_event";
 };
 
 struct stream_response_failure_event : tinyfsm::Event {
-  std::string name = "stream_response_failure_event";
-};
\ No newline at end of file
+  constexpr static const char *NAME = "stream_response_failure_event";
+};
+
+//=============================================================================
+// EVENT TYPE IDS
+//=============================================================================
+
+using bot_events =
+    event_list<generic_event, timeout_event, network_error_event, playback_error_event, server_ready_event,
+               reset_event, terminate_event, init_success_event, camera_error_event, human_presence_event,
+               facial_recognition_response_event, greeting_success_event, greeting_failure_event,
+               user_speech_detected_event, stream_speech_success_event, stream_speech_failure_event,
+               stream_response_success_event, stream_response_failure_event>;
+
+template <typename E>
+constexpr uint8_t event_id = bot_events::id_of<E>();
+
+/* Any event the bot reacts to, by value in a fixed-size slot: what the dispatcher queues*/
+struct bot_event {
+  uint8_t id;
+  alignas(bot_events::MAX_ALIGN) unsigned char data[bot_events::MAX_SIZE];
+
+  bot_event() : id{UINT8_MAX}, data{} {}
+
+  template <typename E, typename = std::enable_if_t<bot_events::contains<E>()>>
+  bot_event(const E &event) : id{event_id<E>}, data{} {
+    std::memcpy(data, &event, sizeof(E));
+  }
+
+  const char *name() const { return id < bot_events::SIZE ? bot_events::NAMES[id] : "none"; }
+};
+
+static_assert(std::is_trivially_copyable_v<bot_event>, "bot_event is queued by value");
@@ -4,19 +4,23 @@
 #include <quill/Logger.h>
 
 #include <client/states/client_states.hpp>
-#include <tinyfsm/tinyfsm.hpp>
 
 //=============================================================================
 // STATE DEFINITIONS
 //=============================================================================
 
 struct fault_state final : bot {
-  auto entry() -> void override {
+  constexpr static client_state ID = client_state::FAULT;
+
+  static auto entry() -> void {
     LOG_WARNING(logger, "[fault::entry] Entering fault state, performing cleanup and logging");
-    // Perform cleanup and logging here
+    // A robot that timed out mid-stream must not keep its server session open
+    stop_camera_stream();
     // After handling the fault, automatically transition back to idle state
-    transit<idle_state>([]() -> void { LOG_WARNING(logger, "[fault::entry] Recovering to idle state"); });
+    bot::post(reset_event{});
   }
 
-  auto get_state() const -> client_state override { return client_state::FAULT; }
+  static auto on_recover(const reset_event&) -> void {
+    LOG_WARNING(logger, "[fault::entry] Recovering to idle state");
+  }
 };
@@ -1,125 +1,85 @@
 #pragma once
 
+#include <chrono>
+#include <memory>
+#include <type_traits>
+
 #include <client/states/client_states.hpp>
-#include <tinyfsm/tinyfsm.hpp>
 
 #include "common/chat_utils.hpp"
+#include "common/utils/timer_wheel.hpp"
 
 //=============================================================================
 // STATE MACHINE DECLARATIONS
 //=============================================================================
 
-struct bot : public tinyfsm::MealyMachine<bot> {
- public:
-  static std::shared_ptr<generic_camera> camera;
-  static std::shared_ptr<robot_rpc_manager> rpc_manager;
-
- protected:
-  std::string current_sid;
-
- public:
-  virtual void react(const reset_event&);
-  virtual void react(const terminate_event&);
-  virtual void react(const generic_event&);
-  virtual void react(const timeout_event&);
-  virtual void react(const network_error_event&);
-  virtual void react(const playback_error_event&);
-  virtual void react(const server_ready_event&);
-  virtual void react(const init_success_event&);
-  virtual void react(const camera_error_event&);
-  virtual void react(const human_presence_event&);
-  virtual void react(const facial_recognition_response_event&);
-  virtual void react(const greeting_success_event&);
-  virtual void react(const greeting_failure_event&);
-  virtual void react(const user_speech_detected_event&);
-  virtual void react(const stream_speech_success_event&);
-  virtual void react(const stream_speech_failure_event&);
-  virtual void react(const stream_response_success_event&);
-  virtual void react(const stream_response_failure_event&);
-
-  virtual void entry();
-  virtual void exit();
-  virtual client_state get_state() const = 0;
-};
-
-//=============================================================================
-// STATE MACHINE DEFINITIONS
-//=============================================================================
-
-inline void bot::react(const reset_event&) {
-  LOG_WARNING(logger, "[{}::react] going to idle state after [reset_event]", to_string(get_state()));
-  transit<idle_state>();
-}
-
-inline void bot::react(const terminate_event&) {
-  LOG_WARNING(logger, "[{}::react] going to terminated state after [terminate_event]", to_string(get_state()));
-  transit<terminated_state>();
-}
+// States are types with static members only, shared by every robot; a robot's own data is its bot_context
+// Their transitions, guards and actions are rows of bot_transitions (impl/transitions_impl.hpp), entry(), exit()
+// and actions run on a dispatcher worker with that robot as context()
+// A state that must not be waited in forever declares constexpr static auto DEADLINE = <duration>: entering it arms
+// a timer on the shared wheel that posts timeout_event once the deadline passes, leaving it cancels the timer
+template <typename S, typename = void>
+struct has_deadline : std::false_type {};
 
-inline void bot::react(const generic_event&) {
-  // Default event handler
-  LOG_WARNING(logger, "[{}::react] cannot handle event [generic_event]", to_string(get_state()));
-}
+template <typename S>
+struct has_deadline<S, std::void_t<decltype(S::DEADLINE)>> : std::true_type {};
 
-inline void bot::react(const timeout_event&) {
-  LOG_WARNING(logger, "[{}::react] cannot handle event [timeout_event]", to_string(get_state()));
-}
+struct bot {
+ private:
+  constexpr static auto DEADLINE_RETRY = std::chrono::milliseconds(100);  // timeout not posted, mailbox full
 
-inline void bot::react(const network_error_event&) {
-  LOG_WARNING(logger, "[{}::react] cannot handle event [network_error_event]", to_string(get_state()));
-}
+  static thread_local bot_context* running;  // robot of the event this worker is running
 
-inline void bot::react(const playback_error_event&) {
-  LOG_WARNING(logger, "[{}::react] cannot handle event [playback_error_event]", to_string(get_state()));
-}
+  static void arm_deadline(timer_wheel::clock::duration after);
+  static void cancel_deadline();
 
-inline void bot::react(const server_ready_event&) {
-  LOG_WARNING(logger, "[{}::react] cannot handle event [server_ready_event]", to_string(get_state()));
-}
-
-inline void bot::react(const init_success_event&) {
-  LOG_WARNING(logger, "[{}::react] cannot handle event [init_success_event]", to_string(get_state()));
-}
+ public:
+  // The robot being run, dispatcher workers only
+  static bot_context& context();
 
-inline void bot::react(const camera_error_event&) {
-  LOG_WARNING(logger, "[{}::react] cannot handle event [camera_error_event]", to_string(get_state()));
-}
+  // For callbacks fired on other threads, posting through it does nothing once the robot is gone
+  static std::weak_ptr<bot_context> self();
 
-inline void bot::react(const human_presence_event&) {
-  LOG_WARNING(logger, "[{}::react] cannot handle event [human_presence_event]", to_string(get_state()));
-}
+  // Queues the event for the robot being run, from its own states; never blocks
+  static bool post(const bot_event& event);
 
-inline void bot::react(const facial_recognition_response_event&) {
-  LOG_WARNING(logger, "[{}::react] cannot handle event [facial_recognition_response_event]", to_string(get_state()));
-}
+  // Queues the event for robot from any thread; never blocks
+  static bool post(const std::weak_ptr<bot_context>& robot, const bot_event& event);
 
-inline void bot::react(const greeting_success_event&) {
-  LOG_WARNING(logger, "[{}::react] cannot handle event [greeting_success_event]", to_string(get_state()));
-}
+  // Dispatcher side, on the robot's worker: enter the initial state, run one event
+  static void start(bot_context& robot);
+  static void dispatch(bot_context& robot, const bot_event& event);
 
-inline void bot::react(const greeting_failure_event&) {
-  LOG_WARNING(logger, "[{}::react] cannot handle event [greeting_failure_event]", to_string(get_state()));
-}
+  // Default entry and exit actions, a state defines its own to replace them
+  static void entry() {}
+  static void exit() {}
 
-inline void bot::react(const user_speech_detected_event&) {
-  LOG_WARNING(logger, "[{}::react] cannot handle event [user_speech_detected_event]", to_string(get_state()));
-}
+  // Run by the transition table around every state's own entry() and exit()
+  template <typename S>
+  static void on_entry() {
+    if constexpr (has_deadline<S>::value) arm_deadline(S::DEADLINE);
+  }
 
-inline void bot::react(const stream_speech_success_event&) {
-  LOG_WARNING(logger, "[{}::react] cannot handle event [stream_speech_success_event]", to_string(get_state()));
-}
+  template <typename S>
+  static void on_exit() {
+    if constexpr (has_deadline<S>::value) cancel_deadline();
+  }
 
-inline void bot::react(const stream_speech_failure_event&) {
-  LOG_WARNING(logger, "[{}::react] cannot handle event [stream_speech_failure_event]", to_string(get_state()));
-}
+  // An event no row of the table takes in state S
+  template <typename S, typename E>
+  static void unhandled(const E&) {
+    LOG_WARNING(logger, "[{}::react] cannot handle event [{}]", to_string(S::ID), E::NAME);
+  }
 
-inline void bot::react(const stream_response_success_event&) {
-  LOG_WARNING(logger, "[{}::react] cannot handle event [stream_response_success_event]", to_string(get_state()));
-}
+  // Actions of the transitions every state has
+  static void on_reset(const reset_event&);
+  static void on_terminate(const terminate_event&);
 
-inline void bot::react(const stream_response_failure_event&) {
-  LOG_WARNING(logger, "[{}::react] cannot handle event [stream_response_failure_event]", to_string(get_state()));
-}
+  // Guards shared by the states waiting for the server
+  static bool is_ready(const server_ready_event& e);
+  static bool is_not_ready(const server_ready_event& e);
 
-inline void bot::entry() {}
-inline void bot::exit() {}
+ protected:
+  // Stops the robot's camera stream if it has one, its server session goes with it
+  static void stop_camera_stream();
+};
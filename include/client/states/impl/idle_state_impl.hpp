@@ -4,24 +4,17 @@
 #include <quill/Logger.h>
 
 #include <client/states/client_states.hpp>
-#include <tinyfsm/tinyfsm.hpp>
 
 //=============================================================================
 // STATE DEFINITIONS
 //=============================================================================
 
 struct idle_state final : bot {
-  auto react(const human_presence_event& e) -> void override {
-    transit<wait_stream_camera_state>(
-        [this, &e]() -> void {
-          // Action function
-          LOG_INFO(logger, "[{}::react] Human present, transitioning to active state", to_string(get_state()));
-        },
-        [&e]() -> bool {
-          // Condition function
-          return e.present;
-        });
-  }
+  constexpr static client_state ID = client_state::IDLE;
+
+  static auto present(const human_presence_event& e) -> bool { return e.present; }
 
-  auto get_state() const -> client_state override { return client_state::IDLE; }
-};
\ No newline at end of file
+  static auto on_present(const human_presence_event&) -> void {
+    LOG_INFO(logger, "[{}::react] Human present, transitioning to active state", to_string(ID));
+  }
+};
@@ -4,35 +4,30 @@
 #include <quill/Logger.h>
 
 #include <client/states/client_states.hpp>
-#include <tinyfsm/tinyfsm.hpp>
 
 //=============================================================================
 // STATE DEFINITIONS
 //=============================================================================
 
 struct init_state final : bot {
-  auto entry() -> void override {
-    LOG_INFO(logger, "[{}::entry] Entering init state, performing initialization", to_string(get_state()));
-    if (!camera->start()) bot::dispatch(camera_error_event{});
-    camera->set_on_human_detected([]() { bot::dispatch(human_presence_event{true}); });
-    camera->set_on_human_lost([]() { bot::dispatch(human_presence_event{false}); });
+  constexpr static client_state ID = client_state::INIT;
+
+  static auto entry() -> void {
+    LOG_INFO(logger, "[{}::entry] Entering init state, performing initialization", to_string(ID));
+    auto& camera = context().camera;
+    if (!camera->start()) bot::post(camera_error_event{});
+    camera->set_on_human_detected([robot = self()]() { bot::post(robot, human_presence_event{true}); });
+    camera->set_on_human_lost([robot = self()]() { bot::post(robot, human_presence_event{false}); });
     // client->set_on_stream_start([]() { bot::dispatch(server_ready_event{true}); });
     // client->set_on_stream_failed([]() { bot::dispatch(server_ready_event{false}); });
-    bot::dispatch(init_success_event{});
+    bot::post(init_success_event{});
   }
 
-  auto react(const init_success_event& e) -> void override {
-    transit<idle_state>([this, &e]() -> void {
-      // Action function
-      LOG_INFO(logger, "[{}::react] Initialization successful, transitioning to idle state", to_string(get_state()));
-    });
-  }
-  auto react(const camera_error_event& e) -> void override {
-    transit<terminated_state>([this, &e]() -> void {
-      // Action function
-      LOG_ERROR(logger, "[{}::react] Camera error occurred, transitioning to terminated state", to_string(get_state()));
-    });
+  static auto on_success(const init_success_event&) -> void {
+    LOG_INFO(logger, "[{}::react] Initialization successful, transitioning to idle state", to_string(ID));
   }
 
-  auto get_state() const -> client_state override { return client_state::INIT; }
-};
\ No newline at end of file
+  static auto on_camera_error(const camera_error_event&) -> void {
+    LOG_ERROR(logger, "[{}::react] Camera error occurred, transitioning to terminated state", to_string(ID));
+  }
+};
@@ -4,51 +4,33 @@
 #include <quill/Logger.h>
 
 #include <client/states/client_states.hpp>
-#include <tinyfsm/tinyfsm.hpp>
 
 //=============================================================================
 // STATE DEFINITIONS
 //=============================================================================
 
 struct stream_camera_state final : bot {
-  auto react(const facial_recognition_response_event& e) -> void override {
-    transit<greeting_state>(
-        [&e]() -> void {
-          // Action function
-          LOG_INFO(logger,
-                   "[stream_camera::react] Facial recognition indicates not greeted, transitioning to greeting_state");
-        },
-        [&e]() -> bool {
-          // Condition function
-          return !e.greeted;
-        });
-
-    transit<wait_stream_speech_state>(
-        [&e]() -> void {
-          // Action function
-          LOG_INFO(
-              logger,
-              "[stream_camera::react] Facial recognition indicates greeted, transitioning to wait_stream_speech_state");
-        },
-        [&e]() -> bool {
-          // Condition function
-          return e.greeted;
-        });
+  constexpr static client_state ID = client_state::STREAM_CAMERA;
+  constexpr static auto DEADLINE = 30s;  // until the server answers with a recognition result
+
+  static auto not_greeted(const facial_recognition_response_event& e) -> bool { return !e.greeted; }
+  static auto greeted(const facial_recognition_response_event& e) -> bool { return e.greeted; }
+
+  static auto on_not_greeted(const facial_recognition_response_event&) -> void {
+    LOG_INFO(logger,
+             "[stream_camera::react] Facial recognition indicates not greeted, transitioning to greeting_state");
   }
 
-  auto react(const timeout_event& e) -> void override {
-    transit<fault_state>([&e]() -> void {
-      // Action function
-      LOG_ERROR(logger, "[stream_camera::react] Timeout occurred, transitioning to fault_state");
-    });
+  static auto on_greeted(const facial_recognition_response_event&) -> void {
+    LOG_INFO(logger,
+             "[stream_camera::react] Facial recognition indicates greeted, transitioning to wait_stream_speech_state");
   }
 
-  auto react(const camera_error_event& e) -> void override {
-    transit<fault_state>([&e]() -> void {
-      // Action function
-      LOG_ERROR(logger, "[stream_camera::react] Camera error occurred, transitioning to fault_state");
-    });
+  static auto on_timeout(const timeout_event&) -> void {
+    LOG_ERROR(logger, "[stream_camera::react] Timeout occurred, transitioning to fault_state");
   }
 
-  auto get_state() const -> client_state override { return client_state::STREAM_CAMERA; }
-};
\ No newline at end of file
+  static auto on_camera_error(const camera_error_event&) -> void {
+    LOG_ERROR(logger, "[stream_camera::react] Camera error occurred, transitioning to fault_state");
+  }
+};
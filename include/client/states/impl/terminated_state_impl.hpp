@@ -4,13 +4,14 @@
 #include <quill/Logger.h>
 
 #include <client/states/client_states.hpp>
-#include <tinyfsm/tinyfsm.hpp>
 
 //=============================================================================
 // STATE DEFINITIONS
 //=============================================================================
 
 struct terminated_state final : bot {
-  auto entry() -> void override { LOG_INFO(logger, "[{}::entry] Entering terminated state", to_string(get_state())); }
-  auto get_state() const -> client_state override { return client_state::TERMINATED; }
-};
\ No newline at end of file
+  constexpr static client_state ID = client_state::TERMINATED;
+  constexpr static bool FINAL = true;
+
+  static auto entry() -> void { LOG_INFO(logger, "[{}::entry] Entering terminated state", to_string(ID)); }
+};
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <client/states/client_states.hpp>
+#include <client/states/transition_table.hpp>
+
+//=============================================================================
+// TRANSITION TABLE
+//=============================================================================
+
+inline bool bot::is_ready(const server_ready_event& e) { return e.ready; }
+inline bool bot::is_not_ready(const server_ready_event& e) { return !e.ready; }
+
+// The initial state comes first
+using bot_states =
+    state_list<init_state, terminated_state, idle_state, wait_stream_camera_state, stream_camera_state, greeting_state,
+               detect_speech_state, wait_stream_speech_state, stream_speech_state, wait_stream_response_state,
+               stream_response_state, fault_state>;
+
+// row<source, event, target, guard, action>, rows of the same source and event are tried in order
+using bot_transitions = transition_table<
+    bot, bot_states, bot_events,
+    /* Initial state */
+    row<init_state, init_success_event, idle_state, nullptr, &init_state::on_success>,
+    row<init_state, camera_error_event, terminated_state, nullptr, &init_state::on_camera_error>,
+
+    /* Idle state */
+    row<idle_state, human_presence_event, wait_stream_camera_state, &idle_state::present, &idle_state::on_present>,
+
+    /* Camera stream */
+    row<wait_stream_camera_state, server_ready_event, stream_camera_state, &bot::is_ready,
+        &wait_stream_camera_state::on_ready>,
+    row<wait_stream_camera_state, server_ready_event, idle_state, &bot::is_not_ready,
+        &wait_stream_camera_state::on_not_ready>,
+    row<wait_stream_camera_state, timeout_event, fault_state>,
+    row<wait_stream_camera_state, camera_error_event, fault_state, nullptr, &wait_stream_camera_state::on_camera_error>,
+    row<stream_camera_state, facial_recognition_response_event, greeting_state, &stream_camera_state::not_greeted,
+        &stream_camera_state::on_not_greeted>,
+    row<stream_camera_state, facial_recognition_response_event, wait_stream_speech_state, &stream_camera_state::greeted,
+        &stream_camera_state::on_greeted>,
+    row<stream_camera_state, timeout_event, fault_state, nullptr, &stream_camera_state::on_timeout>,
+    row<stream_camera_state, camera_error_event, fault_state, nullptr, &stream_camera_state::on_camera_error>,
+
+    /* Greeting */
+    row<greeting_state, greeting_success_event, detect_speech_state, nullptr, &greeting_state::on_success>,
+    row<greeting_state, greeting_failure_event, fault_state, nullptr, &greeting_state::on_failure>,
+    row<greeting_state, timeout_event, fault_state, nullptr, &greeting_state::on_timeout>,
+    row<greeting_state, playback_error_event, fault_state, nullptr, &greeting_state::on_playback_error>,
+
+    /* Detect speech */
+    row<detect_speech_state, user_speech_detected_event, wait_stream_speech_state, &detect_speech_state::detected,
+        &detect_speech_state::on_speech>,
+    row<detect_speech_state, timeout_event, idle_state, nullptr, &detect_speech_state::on_timeout>,
+
+    /* Speech stream */
+    row<wait_stream_speech_state, server_ready_event, stream_speech_state, &bot::is_ready,
+        &wait_stream_speech_state::on_ready>,
+    row<wait_stream_speech_state, server_ready_event, fault_state, &bot::is_not_ready,
+        &wait_stream_speech_state::on_not_ready>,
+    row<wait_stream_speech_state, timeout_event, fault_state, nullptr, &wait_stream_speech_state::on_timeout>,
+    row<stream_speech_state, stream_speech_success_event, wait_stream_response_state, nullptr,
+        &stream_speech_state::on_success>,
+    row<stream_speech_state, stream_speech_failure_event, fault_state, nullptr, &stream_speech_state::on_failure>,
+    row<stream_speech_state, timeout_event, fault_state, nullptr, &stream_speech_state::on_timeout>,
+
+    /* Response stream */
+    row<wait_stream_response_state, server_ready_event, stream_response_state, &bot::is_ready,
+        &wait_stream_response_state::on_ready>,
+    row<wait_stream_response_state, server_ready_event, fault_state, &bot::is_not_ready,
+        &wait_stream_response_state::on_not_ready>,
+    row<wait_stream_response_state, timeout_event, fault_state, nullptr, &wait_stream_response_state::on_timeout>,
+    row<stream_response_state, stream_response_success_event, detect_speech_state, nullptr,
+        &stream_response_state::on_success>,
+    row<stream_response_state, stream_response_failure_event, fault_state, nullptr,
+        &stream_response_state::on_failure>,
+    row<stream_response_state, timeout_event, fault_state, nullptr, &stream_response_state::on_timeout>,
+    row<stream_response_state, playback_error_event, fault_state, nullptr, &stream_response_state::on_playback_error>,
+
+    /* Fault recovery */
+    row<fault_state, reset_event, idle_state, nullptr, &fault_state::on_recover>,
+
+    /* Every state */
+    row<any_state, reset_event, idle_state, nullptr, &bot::on_reset>,
+    row<any_state, terminate_event, terminated_state, nullptr, &bot::on_terminate>>;
@@ -4,72 +4,57 @@
 #include <quill/Logger.h>
 
 #include <client/states/client_states.hpp>
-#include <tinyfsm/tinyfsm.hpp>
 
 //=============================================================================
 // STATE DEFINITIONS
 //=============================================================================
 
 struct wait_stream_camera_state final : bot {
-  auto entry() -> void override {
-    current_sid = rpc_manager->init_camera_stream(
-        [this]() -> void {
+  constexpr static client_state ID = client_state::WAIT_STREAM_CAMERA;
+  constexpr static auto DEADLINE = 10s;  // past the streamer's own 5 s wait for the first frame
+
+  static auto entry() -> void {
+    // Callbacks fire on gRPC and libdatachannel threads, they only post to this robot
+    context().current_sid = context().rpc_manager->init_camera_stream(
+        [robot = self()]() -> void {
           // on_start callback
-          LOG_INFO(logger, "Camera stream started successfully: {}", to_string(get_state()));
-          bot::dispatch(server_ready_event{true});
+          LOG_INFO(logger, "Camera stream started successfully: {}", to_string(ID));
+          bot::post(robot, server_ready_event{true});
         },
-        [this]() -> void {
+        [robot = self()]() -> void {
           // on_failed callback
-          LOG_ERROR(logger, "Camera stream failed to start due to server error: {}", to_string(get_state()));
-          if (!current_sid.empty()) {
-            rpc_manager->stop_camera_stream(current_sid);
-            current_sid.clear();
-          }
-          bot::dispatch(server_ready_event{false});
+          LOG_ERROR(logger, "Camera stream failed to start due to server error: {}", to_string(ID));
+          bot::post(robot, server_ready_event{false});
+        },
+        [robot = self()]() -> void {
+          LOG_ERROR(logger, "Camera stream failed to start due to camera error: {}", to_string(ID));
+          bot::post(robot, camera_error_event{});
         },
-        [this]() -> void {
-          LOG_ERROR(logger, "Camera stream failed to start due to camera error: {}", to_string(get_state()));
-          if (!current_sid.empty()) {
-            rpc_manager->stop_camera_stream(current_sid);
-            current_sid.clear();
-          }
-          bot::dispatch(camera_error_event{});
+        [robot = self()]() -> void {
+          LOG_ERROR(logger, "Camera stream failed to start due to timeout", to_string(ID));
+          bot::post(robot, timeout_event{});
         },
-        [this]() -> void {
-          LOG_ERROR(logger, "Camera stream failed to start due to timeout", to_string(get_state()));
-          bot::dispatch(timeout_event{});
+        [robot = self()]() -> void {
+          LOG_ERROR(logger, "Camera stream ended successfully", to_string(ID));
+          bot::post(robot, facial_recognition_response_event{true});
         },
-        [this]() -> void {
-          LOG_ERROR(logger, "Camera stream ended successfully", to_string(get_state()));
-          bot::dispatch(facial_recognition_response_event{true});
+        [robot = self()](bool greeted) -> void {
+          // on_result callback, the server's recognition outcome for this stream
+          LOG_INFO(logger, "Facial recognition result received, greeted: {}", greeted);
+          bot::post(robot, facial_recognition_response_event{greeted});
         });
   }
 
-  auto react(const server_ready_event& e) -> void override {
-    transit<stream_camera_state>(
-        [this, &e]() -> void {
-          // Action function
-          LOG_INFO(logger, "[{}::react] Server ready for camera stream, transitioning to stream_camera_state",
-                   to_string(get_state()));
-        },
-        [&e]() -> bool {
-          // Condition function
-          return e.ready;
-        });
+  static auto on_ready(const server_ready_event&) -> void {
+    LOG_INFO(logger, "[{}::react] Server ready for camera stream, transitioning to stream_camera_state",
+             to_string(ID));
+  }
 
-    transit<idle_state>(
-        [this, &e]() -> void {
-          // Action function
-          LOG_ERROR(logger, "[{}::react] Server not ready for camera stream, transitioning to idle_state",
-                    to_string(get_state()));
-        },
-        [&e]() -> bool {
-          // Condition function
-          return !e.ready;
-        });
+  static auto on_not_ready(const server_ready_event&) -> void {
+    LOG_ERROR(logger, "[{}::react] Server not ready for camera stream, transitioning to idle_state", to_string(ID));
+    stop_camera_stream();
   }
 
-  auto react(const timeout_event& e) -> void override { transit<fault_state>(); }
-  auto react(const camera_error_event& e) -> void override { transit<fault_state>(); }
-  auto get_state() const -> client_state override { return client_state::WAIT_STREAM_CAMERA; }
-};
\ No newline at end of file
+  // Stops the stream of a failed start, on the FSM rather than on the thread reporting the failure
+  static auto on_camera_error(const camera_error_event&) -> void { stop_camera_stream(); }
+};
@@ -4,41 +4,25 @@
 #include <quill/Logger.h>
 
 #include <client/states/client_states.hpp>
-#include <tinyfsm/tinyfsm.hpp>
 
 //=============================================================================
 // STATE DEFINITIONS
 //=============================================================================
 
 struct wait_stream_response_state final : bot {
-  auto react(const server_ready_event& e) -> void override {
-    transit<stream_response_state>(
-        [&e]() -> void {
-          // Action function
-          LOG_INFO(logger, "[wait_stream_response::react] Server ready for response stream, transitioning to stream_response_state");
-        },
-        [&e]() -> bool {
-          // Condition function
-          return e.ready;
-        });
+  constexpr static client_state ID = client_state::WAIT_STREAM_RESPONSE;
+  constexpr static auto DEADLINE = 10s;
 
-    transit<fault_state>(
-        [&e]() -> void {
-          // Action function
-          LOG_ERROR(logger, "[wait_stream_response::react] Fault occurred, transitioning to fault_state");
-        },
-        [&e]() -> bool {
-          // Condition function
-          return !e.ready;
-        });
+  static auto on_ready(const server_ready_event&) -> void {
+    LOG_INFO(logger,
+             "[wait_stream_response::react] Server ready for response stream, transitioning to stream_response_state");
   }
 
-  auto react(const timeout_event& e) -> void override {
-    transit<fault_state>([&e]() -> void {
-      // Action function
-      LOG_ERROR(logger, "[wait_stream_response::react] Timeout occurred, transitioning to fault_state");
-    });
+  static auto on_not_ready(const server_ready_event&) -> void {
+    LOG_ERROR(logger, "[wait_stream_response::react] Fault occurred, transitioning to fault_state");
   }
 
-  auto get_state() const -> client_state override { return client_state::WAIT_STREAM_RESPONSE; }
-};
\ No newline at end of file
+  static auto on_timeout(const timeout_event&) -> void {
+    LOG_ERROR(logger, "[wait_stream_response::react] Timeout occurred, transitioning to fault_state");
+  }
+};
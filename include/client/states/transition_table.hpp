@@ -0,0 +1,259 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+// State machine compiled from a declarative transition table into a [state][event] jump table
+//
+// row<Source, Event, Target, Guard, Action>: in Source, Event moves to Target when Guard(event) holds (always when
+// it is nullptr), running Source::exit(), Action(event) and Target::entry() in that order. Source any_state matches
+// every state but the FINAL ones, nothing leaves a FINAL state. The rows of one (state, event) are tried in table
+// order and the first whose guard holds wins, an event no row takes goes to Machine::unhandled<S, E>().
+// Machine::on_exit<S>() and Machine::on_entry<T>() run around the state's own exit() and entry(), for what every
+// state shares
+// States are types with a static entry(), exit() and ID, a state's index is its position in the state list and an
+// event's the one of its event_list. Every cell of the jump table is a function with the matching rows inlined, so
+// dispatch is one indirect call and never walks the table
+// Checked at build time: a row that can never fire because an earlier unguarded row takes its event, a state with
+// no way out (unless it is FINAL), a row out of a FINAL state, a state no row leads to (except the initial one, first
+// in the list)
+
+// Compile-time registry of event types: an event's id is its index in the list, NAMES[id] its name
+template <typename... EE>
+struct event_list {
+  constexpr static size_t SIZE = sizeof...(EE);
+  constexpr static size_t MAX_SIZE = std::max({sizeof(EE)...});
+  constexpr static size_t MAX_ALIGN = std::max({alignof(EE)...});
+  constexpr static const char *NAMES[SIZE] = {EE::NAME...};
+
+  static_assert(SIZE < UINT8_MAX, "event ids are one byte");
+  static_assert((std::is_trivially_copyable_v<EE> && ...), "events are copied into queue slots bytewise");
+  static_assert((std::is_trivially_destructible_v<EE> && ...), "events are copied into queue slots bytewise");
+
+  template <typename E>
+  constexpr static uint8_t id_of() {
+    constexpr bool matches[SIZE] = {std::is_same_v<E, EE>...};
+    for (size_t i = 0; i < SIZE; ++i) {
+      if (matches[i]) return static_cast<uint8_t>(i);
+    }
+    return UINT8_MAX;
+  }
+
+  template <typename E>
+  constexpr static bool contains() {
+    return id_of<E>() != UINT8_MAX;
+  }
+};
+
+struct any_state {};
+
+// States declare constexpr static bool FINAL = true when they have no way out on purpose
+template <typename S, typename = void>
+struct is_final_state : std::false_type {};
+
+template <typename S>
+struct is_final_state<S, std::void_t<decltype(S::FINAL)>> : std::bool_constant<S::FINAL> {};
+
+template <typename S, typename E, typename T, auto Guard = nullptr, auto Action = nullptr>
+struct row {
+  using source = S;
+  using event = E;
+  using target = T;
+
+  constexpr static bool GUARDED = !std::is_null_pointer_v<decltype(Guard)>;
+
+  static bool guard(const E &e) {
+    if constexpr (GUARDED) {
+      return Guard(e);
+    } else {
+      return true;
+    }
+  }
+
+  static void action(const E &e) {
+    if constexpr (!std::is_null_pointer_v<decltype(Action)>) Action(e);
+  }
+};
+
+template <typename... SS>
+struct state_list {
+  constexpr static size_t SIZE = sizeof...(SS);
+  constexpr static uint8_t NONE = UINT8_MAX;
+
+  static_assert(SIZE > 0 && SIZE < NONE, "state indices are one byte");
+
+  template <typename S>
+  constexpr static uint8_t index_of() {
+    constexpr bool matches[SIZE] = {std::is_same_v<S, SS>...};
+    for (size_t i = 0; i < SIZE; ++i) {
+      if (matches[i]) return static_cast<uint8_t>(i);
+    }
+    return NONE;
+  }
+};
+
+template <typename Machine, typename States, typename Events, typename... Rows>
+class transition_table;
+
+template <typename Machine, typename... SS, typename... EE, typename... Rows>
+class transition_table<Machine, state_list<SS...>, event_list<EE...>, Rows...> {
+ public:
+  using states = state_list<SS...>;
+  using events = event_list<EE...>;
+
+  constexpr static uint8_t NONE = states::NONE;
+
+ private:
+  constexpr static size_t STATES = states::SIZE;
+  constexpr static size_t EVENTS = events::SIZE;
+  constexpr static uint8_t ANY = NONE - 1;  // source index of any_state rows
+
+  using initial_state = std::tuple_element_t<0, std::tuple<SS...>>;
+  using handler = void (*)(std::atomic<uint8_t> &, const unsigned char *);
+
+  template <typename S>
+  constexpr static uint8_t source_index() {
+    return std::is_same_v<S, any_state> ? ANY : states::template index_of<S>();
+  }
+
+  template <typename R, typename S, typename E>
+  constexpr static bool matches() {
+    return std::is_same_v<typename R::event, E> &&
+           (std::is_same_v<typename R::source, S> ||
+            (std::is_same_v<typename R::source, any_state> && !is_final_state<S>::value));
+  }
+
+  template <typename R, typename S, typename E>
+  static bool try_row(std::atomic<uint8_t> &state, const E &event) {
+    if constexpr (matches<R, S, E>()) {
+      if (!R::guard(event)) return false;
+      S::exit();
+      Machine::template on_exit<S>();
+      R::action(event);
+      state.store(states::template index_of<typename R::target>(), std::memory_order_relaxed);
+      Machine::template on_entry<typename R::target>();
+      R::target::entry();
+      return true;
+    } else {
+      return false;
+    }
+  }
+
+  template <typename S, typename E>
+  static void handle(std::atomic<uint8_t> &state, const unsigned char *data) {
+    E event;
+    std::memcpy(&event, data, sizeof(E));
+    if (!(try_row<Rows, S, E>(state, event) || ...)) Machine::template unhandled<S, E>(event);
+  }
+
+  template <size_t... I>
+  constexpr static std::array<handler, sizeof...(I)> make_table(std::index_sequence<I...>) {
+    return {{&handle<std::tuple_element_t<I / EVENTS, std::tuple<SS...>>,
+                     std::tuple_element_t<I % EVENTS, std::tuple<EE...>>>...}};
+  }
+
+  constexpr static std::array<uint8_t, sizeof...(Rows)> sources() {
+    return {source_index<typename Rows::source>()...};
+  }
+  constexpr static std::array<uint8_t, sizeof...(Rows)> targets() {
+    return {states::template index_of<typename Rows::target>()...};
+  }
+  constexpr static std::array<uint8_t, sizeof...(Rows)> row_events() {
+    return {events::template id_of<typename Rows::event>()...};
+  }
+
+  // First row an earlier unguarded row always takes the event from, NONE if there is none
+  constexpr static size_t shadowed_row() {
+    constexpr auto SOURCES = sources();
+    constexpr auto EVENT_IDS = row_events();
+    constexpr bool GUARDED[] = {Rows::GUARDED...};
+    for (size_t j = 0; j < SOURCES.size(); ++j) {
+      for (size_t i = 0; i < j; ++i) {
+        if (GUARDED[i] || EVENT_IDS[i] != EVENT_IDS[j]) continue;
+        if (SOURCES[i] == ANY || SOURCES[i] == SOURCES[j]) return j;
+      }
+    }
+    return NONE;
+  }
+
+  // First non-final state without a row of its own out of it, NONE if there is none
+  constexpr static size_t dead_end_state() {
+    constexpr auto SOURCES = sources();
+    constexpr bool FINAL[] = {is_final_state<SS>::value...};
+    for (size_t s = 0; s < STATES; ++s) {
+      auto way_out = FINAL[s];
+      for (size_t r = 0; r < SOURCES.size() && !way_out; ++r) way_out = SOURCES[r] == s;
+      if (!way_out) return s;
+    }
+    return NONE;
+  }
+
+  // First state after the initial one that no row leads to, NONE if there is none
+  constexpr static size_t unreachable_state() {
+    constexpr auto TARGETS = targets();
+    for (size_t s = 1; s < STATES; ++s) {
+      auto reached = false;
+      for (size_t r = 0; r < TARGETS.size() && !reached; ++r) reached = TARGETS[r] == s;
+      if (!reached) return s;
+    }
+    return NONE;
+  }
+
+  template <typename R>
+  static void append_edge(std::string &out) {
+    out += "  \"";
+    if constexpr (std::is_same_v<typename R::source, any_state>) {
+      out += "*";
+    } else {
+      out += to_string(R::source::ID);
+    }
+    out += "\" -> \"";
+    out += to_string(R::target::ID);
+    out += "\" [label=\"";
+    out += R::event::NAME;
+    out += R::GUARDED ? "?\", style=dashed];\n" : "\"];\n";
+  }
+
+ public:
+  constexpr static auto IDS = std::array{SS::ID...};
+
+  // Enters the initial state
+  static void start(std::atomic<uint8_t> &state) {
+    static_assert(((states::template index_of<typename Rows::target>() != NONE) && ...),
+                  "transition to a state missing from the state list");
+    static_assert(((source_index<typename Rows::source>() != NONE) && ...),
+                  "transition from a state missing from the state list");
+    static_assert(((events::template id_of<typename Rows::event>() != UINT8_MAX) && ...),
+                  "transition on an event missing from the event list");
+    static_assert(shadowed_row() == NONE, "a row can never fire, an earlier unguarded row takes its event");
+    static_assert(dead_end_state() == NONE, "a state has no transition out of it and is not FINAL");
+    static_assert((!is_final_state<typename Rows::source>::value && ...), "transition out of a FINAL state");
+    static_assert(unreachable_state() == NONE, "a state is not the target of any transition");
+
+    state.store(0, std::memory_order_relaxed);
+    Machine::template on_entry<initial_state>();
+    initial_state::entry();
+  }
+
+  // Runs the event with id event_id, its bytes at data, in the state indexed by state
+  static void dispatch(std::atomic<uint8_t> &state, uint8_t event_id, const unsigned char *data) {
+    constexpr static auto TABLE = make_table(std::make_index_sequence<STATES * EVENTS>{});
+    auto current = state.load(std::memory_order_relaxed);
+    if (current < STATES && event_id < EVENTS) TABLE[current * EVENTS + event_id](state, data);
+  }
+
+  // Graphviz source of the table, guarded transitions dashed and any_state rows drawn from "*"
+  static std::string to_dot(const std::string &name) {
+    auto out = "digraph " + name + " {\n  \"" + to_string(initial_state::ID) + "\" [shape=doublecircle];\n";
+    (append_edge<Rows>(out), ...);
+    return out + "}\n";
+  }
+};
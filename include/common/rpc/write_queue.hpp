@@ -0,0 +1,63 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+
+// Serializes writes on a gRPC callback stream, which allows only one write in flight
+// Messages can be queued from any thread, the caller starts the write for whatever push() / pop() returns
+// Returned pointers stay valid until the matching OnWriteDone, a deque never moves its elements on push_back
+//
+// Closing is deferred until the in-flight write is done, exactly one of close() / pop() reports that the
+// stream can be finished (Finish on the server, StartWritesDone on the client)
+
+template <typename T>
+class write_queue {
+ private:
+  std::mutex mtx;
+  std::deque<T> pending;  // front is the message being written
+  bool writing{false};
+  bool closing{false};
+
+ public:
+  // Returns the message to start writing now, nullptr if a write is in flight or the queue is closed
+  const T *push(T message) {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (closing) return nullptr;
+
+    pending.push_back(std::move(message));
+    if (writing) return nullptr;
+
+    writing = true;
+    return &pending.front();
+  }
+
+  // Called from OnWriteDone, returns the next message to write
+  // Sets finish when the stream is drained and closing, a failed write drops everything queued
+  const T *pop(bool ok, bool &finish) {
+    std::lock_guard<std::mutex> lock(mtx);
+    finish = false;
+
+    pending.pop_front();
+    if (!ok) {
+      pending.clear();
+      closing = true;
+    }
+
+    if (pending.empty()) {
+      writing = false;
+      finish = closing;
+      return nullptr;
+    }
+
+    return &pending.front();
+  }
+
+  // Stops accepting messages, returns true if the stream can be finished right away
+  bool close() {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (closing) return false;
+
+    closing = true;
+    return !writing;
+  }
+};
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// H.264 RTP payload helpers (RFC 6184), only the packetization modes the camera pipeline uses:
+// single NAL unit, STAP-A and FU-A
+
+namespace h264 {
+
+enum nal_type : uint8_t {
+  NAL_SLICE = 1,
+  NAL_IDR = 5,
+  NAL_SEI = 6,
+  NAL_SPS = 7,
+  NAL_PPS = 8,
+  NAL_AUD = 9,
+  NAL_STAP_A = 24,
+  NAL_FU_A = 28,
+};
+
+// What a single RTP payload carries, FU-A fragments report the type of the fragmented NAL unit
+struct payload_info {
+  bool has_sps{false};
+  bool has_pps{false};
+  bool has_idr{false};
+  bool has_slice{false};
+  bool fu_start{false};
+  bool fu_end{false};
+  bool is_fragment{false};
+  bool is_reference{false};  // nal_ref_idc != 0 on any carried NAL unit
+};
+
+inline void mark(payload_info &info, uint8_t header) {
+  switch (header & 0x1F) {
+    case NAL_SPS:
+      info.has_sps = true;
+      break;
+    case NAL_PPS:
+      info.has_pps = true;
+      break;
+    case NAL_IDR:
+      info.has_idr = true;
+      break;
+    case NAL_SLICE:
+      info.has_slice = true;
+      break;
+    default:
+      break;
+  }
+  if (header & 0x60) info.is_reference = true;
+}
+
+inline payload_info inspect(const uint8_t *payload, size_t len) {
+  auto info = payload_info{};
+  if (len < 1) return info;
+
+  auto type = payload[0] & 0x1F;
+  if (type == NAL_STAP_A) {
+    // [STAP-A header][size16][NALU][size16][NALU]...
+    for (size_t offset = 1; offset + 2 < len;) {
+      auto size = (static_cast<size_t>(payload[offset]) << 8) | payload[offset + 1];
+      offset += 2;
+      if (size == 0 || offset + size > len) break;
+      mark(info, payload[offset]);
+      offset += size;
+    }
+  } else if (type == NAL_FU_A) {
+    if (len < 2) return info;
+    info.is_fragment = true;
+    info.fu_start = (payload[1] & 0x80) != 0;
+    info.fu_end = (payload[1] & 0x40) != 0;
+    mark(info, static_cast<uint8_t>((payload[0] & 0xE0) | (payload[1] & 0x1F)));
+  } else if (type >= 1 && type <= 23) {
+    mark(info, payload[0]);
+  }
+
+  return info;
+}
+
+}  // namespace h264
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// RTCP transport layer feedback, Generic NACK (RFC 4585 section 6.2.1)
+// [V=2 P FMT=1][PT=205][length][sender SSRC][media SSRC] then FCI entries of [PID 16][BLP 16]
+// PID is a lost sequence number, bit i of BLP marks PID + i + 1 as lost as well
+
+namespace rtcp_nack {
+
+constexpr uint8_t PAYLOAD_TYPE = 205;  // RTPFB
+constexpr uint8_t FORMAT = 1;          // Generic NACK
+constexpr size_t HEADER_SIZE = 12;
+constexpr size_t ENTRY_SIZE = 4;
+
+inline void put16(uint8_t *out, uint16_t value) {
+  out[0] = static_cast<uint8_t>(value >> 8);
+  out[1] = static_cast<uint8_t>(value);
+}
+
+inline void put32(uint8_t *out, uint32_t value) {
+  put16(out, static_cast<uint16_t>(value >> 16));
+  put16(out + 2, static_cast<uint16_t>(value));
+}
+
+inline uint16_t get16(const uint8_t *in) { return static_cast<uint16_t>((in[0] << 8) | in[1]); }
+
+inline uint32_t get32(const uint8_t *in) { return (static_cast<uint32_t>(get16(in)) << 16) | get16(in + 2); }
+
+// Worst case size for count sequence numbers
+constexpr size_t max_size(size_t count) { return HEADER_SIZE + ENTRY_SIZE * count; }
+
+// Packs ascending (wrap-aware) sequence numbers into out, returns the packet size, out needs max_size(count)
+inline size_t build(uint8_t *out, uint32_t sender_ssrc, uint32_t media_ssrc, const uint16_t *seqs, size_t count) {
+  auto size = HEADER_SIZE;
+
+  for (size_t i = 0; i < count;) {
+    auto pid = seqs[i++];
+    auto blp = uint16_t{0};
+    while (i < count && static_cast<uint16_t>(seqs[i] - pid - 1) < 16) {
+      blp |= static_cast<uint16_t>(1u << static_cast<uint16_t>(seqs[i] - pid - 1));
+      ++i;
+    }
+
+    put16(out + size, pid);
+    put16(out + size + 2, blp);
+    size += ENTRY_SIZE;
+  }
+
+  out[0] = 0x80 | FORMAT;
+  out[1] = PAYLOAD_TYPE;
+  put16(out + 2, static_cast<uint16_t>(size / 4 - 1));
+  put32(out + 4, sender_ssrc);
+  put32(out + 8, media_ssrc);
+  return size;
+}
+
+// Calls fn(media_ssrc, seq) for every sequence number requested by the NACKs in a compound RTCP packet
+template <typename Fn>
+void for_each_lost(const uint8_t *data, size_t len, Fn &&fn) {
+  for (size_t offset = 0; offset + 4 <= len;) {
+    auto packet = data + offset;
+    auto packet_len = 4 * (static_cast<size_t>(get16(packet + 2)) + 1);
+    if ((packet[0] >> 6) != 2 || offset + packet_len > len) return;
+
+    if (packet[1] == PAYLOAD_TYPE && (packet[0] & 0x1F) == FORMAT && packet_len >= HEADER_SIZE) {
+      auto media_ssrc = get32(packet + 8);
+      for (auto entry = packet + HEADER_SIZE; entry + ENTRY_SIZE <= packet + packet_len; entry += ENTRY_SIZE) {
+        auto pid = get16(entry);
+        auto blp = get16(entry + 2);
+        fn(media_ssrc, pid);
+        for (uint16_t bit = 0; bit < 16; ++bit) {
+          if (blp & (1u << bit)) fn(media_ssrc, static_cast<uint16_t>(pid + bit + 1));
+        }
+      }
+    }
+
+    offset += packet_len;
+  }
+}
+
+}  // namespace rtcp_nack
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Non-owning view over an RTP packet (RFC 3550), parsing never copies the payload
+
+struct rtp_view {
+  uint16_t seq;
+  uint32_t timestamp;
+  uint32_t ssrc;
+  uint8_t payload_type;
+  bool marker;
+  const uint8_t *payload;
+  size_t payload_len;
+
+  // Returns false for anything that is not a well-formed RTP v2 packet
+  static bool parse(const void *data, size_t len, rtp_view &out) {
+    constexpr size_t HEADER_SIZE = 12;
+    auto bytes = static_cast<const uint8_t *>(data);
+    if (len < HEADER_SIZE || (bytes[0] >> 6) != 2) return false;
+
+    auto offset = HEADER_SIZE + 4 * static_cast<size_t>(bytes[0] & 0x0F);  // CSRC list
+    if (len < offset) return false;
+
+    if (bytes[0] & 0x10) {  // header extension
+      if (len < offset + 4) return false;
+      offset += 4 + 4 * ((static_cast<size_t>(bytes[offset + 2]) << 8) | bytes[offset + 3]);
+      if (len < offset) return false;
+    }
+
+    auto end = len;
+    if (bytes[0] & 0x20) {  // padding, last byte holds the padding length
+      auto padding = static_cast<size_t>(bytes[len - 1]);
+      if (padding == 0 || end < offset + padding) return false;
+      end -= padding;
+    }
+
+    out.marker = (bytes[1] & 0x80) != 0;
+    out.payload_type = bytes[1] & 0x7F;
+    out.seq = static_cast<uint16_t>((bytes[2] << 8) | bytes[3]);
+    out.timestamp = (static_cast<uint32_t>(bytes[4]) << 24) | (static_cast<uint32_t>(bytes[5]) << 16) |
+                    (static_cast<uint32_t>(bytes[6]) << 8) | bytes[7];
+    out.ssrc = (static_cast<uint32_t>(bytes[8]) << 24) | (static_cast<uint32_t>(bytes[9]) << 16) |
+               (static_cast<uint32_t>(bytes[10]) << 8) | bytes[11];
+    out.payload = bytes + offset;
+    out.payload_len = end - offset;
+    return true;
+  }
+};
+
+// Wrap-aware sequence number comparison, true if a comes before b
+inline bool seq_before(uint16_t a, uint16_t b) { return static_cast<int16_t>(a - b) < 0; }
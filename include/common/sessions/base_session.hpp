@@ -1,12 +1,19 @@
 #pragma once
 #include <string>
 #include <atomic>
+#include <functional>
 
 class base_session {
  protected:
   // Session ID
   std::string session_id;
   std::atomic<bool> session_active; // mark inactive for cleanup
+  std::function<void()> on_inactive; // set by the owning manager, reclaims the session
+
+  // Marks the session for cleanup, the manager hears about it once
+  void deactivate() {
+    if (session_active.exchange(false) && on_inactive) on_inactive();
+  }
 
  public:
   base_session(const std::string& sid) : session_id{sid}, session_active{true} {}
@@ -14,4 +21,7 @@ class base_session {
 
   std::string get_id() { return session_id; }
   bool is_active() const { return session_active.load(); }
-};
\ No newline at end of file
+
+  // Must be set before the session starts, invoked from whichever thread deactivates it
+  void set_on_inactive(std::function<void()> callback) { on_inactive = std::move(callback); }
+};
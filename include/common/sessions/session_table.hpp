@@ -0,0 +1,137 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+// Session map shared by the rpc managers, sharded so lookups of different sessions never contend
+//
+// Each shard is a mutex and a map on its own cache line, picked by the hash of the session id
+// Admission is decoupled from insertion: reserve() claims one of the capacity slots with a single atomic
+// compare-exchange, the caller then builds the session (which may be slow) without holding any lock
+// and publishes it with insert(), or drops the reservation to give the slot back
+// Locks are only held for the map operation itself, callbacks passed in run under one shard lock
+
+template <typename V>
+class session_table {
+ public:
+  // Move-only claim on one slot, released on destruction unless consumed by insert()
+  class reservation {
+   private:
+    session_table *owner;
+
+   public:
+    reservation() : owner{nullptr} {}
+    explicit reservation(session_table *owner) : owner{owner} {}
+    reservation(reservation &&other) noexcept : owner{other.owner} { other.owner = nullptr; }
+    reservation &operator=(reservation &&other) noexcept {
+      if (this != &other) {
+        release();
+        owner = other.owner;
+        other.owner = nullptr;
+      }
+      return *this;
+    }
+    reservation(const reservation &) = delete;
+    reservation &operator=(const reservation &) = delete;
+    ~reservation() { release(); }
+
+    void release() {
+      if (owner) owner->count.fetch_sub(1, std::memory_order_release);
+      owner = nullptr;
+    }
+
+    explicit operator bool() const { return owner != nullptr; }
+
+    friend class session_table;
+  };
+
+ private:
+  constexpr static size_t SHARDS = 16;  // power of two
+
+  struct alignas(64) shard {
+    std::mutex mtx;
+    std::unordered_map<std::string, V> entries;
+  };
+
+  size_t capacity;
+  alignas(64) std::atomic<size_t> count;  // reserved + inserted
+  std::array<shard, SHARDS> shards;
+
+  shard &shard_of(const std::string &key) { return shards[std::hash<std::string>{}(key) & (SHARDS - 1)]; }
+
+ public:
+  explicit session_table(size_t capacity) : capacity{capacity}, count{0} {}
+
+  session_table(const session_table &) = delete;
+  session_table &operator=(const session_table &) = delete;
+
+  // An empty reservation when the table is full
+  reservation reserve() {
+    auto current = count.load(std::memory_order_relaxed);
+    do {
+      if (current >= capacity) return reservation{};
+    } while (!count.compare_exchange_weak(current, current + 1, std::memory_order_acquire,
+                                          std::memory_order_relaxed));
+    return reservation{this};
+  }
+
+  // Publishes value under key using the reservation, false (reservation released) if the key is taken
+  bool insert(reservation &&slot, const std::string &key, V value) {
+    if (!slot || slot.owner != this) return false;
+
+    auto &s = shard_of(key);
+    std::lock_guard<std::mutex> lock(s.mtx);
+    if (!s.entries.try_emplace(key, std::move(value)).second) {
+      slot.release();
+      return false;
+    }
+    slot.owner = nullptr;  // the slot now belongs to the entry
+    return true;
+  }
+
+  std::optional<V> find(const std::string &key) {
+    auto &s = shard_of(key);
+    std::lock_guard<std::mutex> lock(s.mtx);
+    auto it = s.entries.find(key);
+    if (it == s.entries.end()) return std::nullopt;
+    return it->second;
+  }
+
+  std::optional<V> erase(const std::string &key) {
+    return erase_if(key, [](V &) { return true; });
+  }
+
+  // Erases the entry if pred(value) returns true, under the shard lock; returns the erased value
+  template <typename Pred>
+  std::optional<V> erase_if(const std::string &key, Pred &&pred) {
+    auto &s = shard_of(key);
+    std::lock_guard<std::mutex> lock(s.mtx);
+    auto it = s.entries.find(key);
+    if (it == s.entries.end() || !pred(it->second)) return std::nullopt;
+
+    auto value = std::optional<V>{std::move(it->second)};
+    s.entries.erase(it);
+    count.fetch_sub(1, std::memory_order_release);
+    return value;
+  }
+
+  // Visits every entry one shard at a time, entries added or removed meanwhile may or may not be seen
+  template <typename Fn>
+  void for_each(Fn &&fn) {
+    for (auto &s : shards) {
+      std::lock_guard<std::mutex> lock(s.mtx);
+      for (auto &[key, value] : s.entries) fn(key, value);
+    }
+  }
+
+  // Sessions plus pending reservations
+  size_t size() const { return count.load(std::memory_order_relaxed); }
+  size_t get_capacity() const { return capacity; }
+};
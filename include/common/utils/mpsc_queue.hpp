@@ -0,0 +1,78 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+// Bounded multi-producer single-consumer ring (Vyukov), no locks on either side
+//
+// Every cell carries a sequence number: a producer claims a position with one compare-exchange on tail and publishes
+// the cell by advancing its sequence, the consumer reads the cell once its sequence says it was published
+// try_push() fails instead of waiting when the ring is full, so a producer never waits for the consumer or another
+// producer. try_pop() may fail for a moment while the producer that claimed the next position is still writing it
+
+template <typename T>
+class mpsc_queue {
+ private:
+  struct alignas(64) cell {
+    std::atomic<size_t> sequence;
+    T value;
+  };
+
+  size_t mask;
+  std::unique_ptr<cell[]> cells;
+  alignas(64) std::atomic<size_t> tail;  // next position to claim, producers
+  alignas(64) size_t head;               // next position to read, consumer only
+
+  static size_t round_up(size_t capacity) {
+    auto rounded = size_t{2};
+    while (rounded < capacity) rounded <<= 1;
+    return rounded;
+  }
+
+ public:
+  // capacity is rounded up to a power of two
+  explicit mpsc_queue(size_t capacity)
+      : mask{round_up(capacity) - 1}, cells{std::make_unique<cell[]>(mask + 1)}, tail{0}, head{0} {
+    for (size_t i = 0; i <= mask; ++i) cells[i].sequence.store(i, std::memory_order_relaxed);
+  }
+
+  mpsc_queue(const mpsc_queue &) = delete;
+  mpsc_queue &operator=(const mpsc_queue &) = delete;
+
+  // Any thread, false if the ring is full
+  bool try_push(T value) {
+    auto position = tail.load(std::memory_order_relaxed);
+    while (true) {
+      auto &c = cells[position & mask];
+      auto sequence = c.sequence.load(std::memory_order_acquire);
+      auto diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+      if (diff == 0) {
+        if (tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+          c.value = std::move(value);
+          c.sequence.store(position + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;  // the consumer has not freed this cell yet
+      } else {
+        position = tail.load(std::memory_order_relaxed);  // another producer took it
+      }
+    }
+  }
+
+  // Consumer thread only, false if the next cell is empty or not published yet
+  bool try_pop(T &out) {
+    auto &c = cells[head & mask];
+    if (c.sequence.load(std::memory_order_acquire) != head + 1) return false;
+
+    out = std::move(c.value);
+    c.sequence.store(head + mask + 1, std::memory_order_release);  // free for the producer one lap ahead
+    ++head;
+    return true;
+  }
+
+  size_t capacity() const { return mask + 1; }
+};
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Copy-on-write snapshot with quiescent-state based reclamation for a single reader thread
+//
+// The reader enters a read section, loads the current snapshot and uses it without any lock:
+// entering and leaving are a couple of atomic stores, read() is one atomic load
+// Writers copy the current value, modify the copy and publish it, then wait for the reader to leave
+// the section it may have been in before freeing the old snapshot
+// A writer running on the reader thread inside a read section (e.g. from a callback) cannot wait for
+// itself, its old snapshot is retired and freed when that read section ends
+
+template <typename T>
+class rcu_snapshot {
+ private:
+  constexpr static uint64_t OFFLINE = 0;
+
+  std::atomic<const T *> current;
+  std::atomic<uint64_t> epoch;         // bumped on every publish, starts at 1
+  std::atomic<uint64_t> reader_epoch;  // epoch seen when the reader entered, OFFLINE outside a read section
+  std::atomic<std::thread::id> reader_thread;
+
+  std::mutex writer_mtx;  // serializes writers, held only briefly and never while waiting for the reader
+  std::vector<std::unique_ptr<const T>> retired;
+  std::atomic<bool> has_retired;
+
+  void enter() {
+    reader_thread.store(std::this_thread::get_id(), std::memory_order_relaxed);
+    // seq_cst store here and seq_cst load of current in the guard, a writer either sees this epoch or publishes
+    // before the load; acquire/release alone would let both miss each other and free a snapshot still in use
+    reader_epoch.store(epoch.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+  }
+
+  void exit() {
+    reader_epoch.store(OFFLINE, std::memory_order_release);
+
+    // Snapshots replaced by this thread while it was reading
+    if (has_retired.load(std::memory_order_acquire)) {
+      auto expired = std::vector<std::unique_ptr<const T>>{};
+      {
+        std::lock_guard<std::mutex> lock(writer_mtx);
+        expired.swap(retired);
+        has_retired.store(false, std::memory_order_relaxed);
+      }
+      // expired snapshots are freed here, outside of the writer lock
+    }
+  }
+
+  bool in_own_read_section() const {
+    return reader_epoch.load() != OFFLINE &&
+           reader_thread.load(std::memory_order_relaxed) == std::this_thread::get_id();
+  }
+
+  // Waits until the reader is outside of any section that started before publish_epoch
+  void synchronize(uint64_t publish_epoch) const {
+    while (true) {
+      auto seen = reader_epoch.load();
+      if (seen == OFFLINE || seen >= publish_epoch) return;
+      std::this_thread::yield();
+    }
+  }
+
+ public:
+  class read_guard {
+   private:
+    rcu_snapshot &owner;
+
+   public:
+    explicit read_guard(rcu_snapshot &owner) : owner{owner} { owner.enter(); }
+    ~read_guard() { owner.exit(); }
+    read_guard(const read_guard &) = delete;
+    read_guard &operator=(const read_guard &) = delete;
+
+    const T &operator*() const { return *owner.current.load(std::memory_order_seq_cst); }
+    const T *operator->() const { return owner.current.load(std::memory_order_seq_cst); }
+  };
+
+  rcu_snapshot() : current{new T{}}, epoch{1}, reader_epoch{OFFLINE}, has_retired{false} {}
+  ~rcu_snapshot() { delete current.load(); }
+
+  rcu_snapshot(const rcu_snapshot &) = delete;
+  rcu_snapshot &operator=(const rcu_snapshot &) = delete;
+
+  // Reader side, one thread only
+  read_guard read() { return read_guard{*this}; }
+
+  // Writer side, any thread, allocates a full copy so keep T small (e.g. a vector of pointers)
+  template <typename Fn>
+  void update(Fn &&modify) {
+    auto old = std::unique_ptr<const T>{};
+    auto publish_epoch = uint64_t{0};
+    {
+      std::lock_guard<std::mutex> lock(writer_mtx);
+
+      auto next = std::make_unique<T>(*current.load(std::memory_order_relaxed));
+      modify(*next);
+
+      old.reset(current.exchange(next.release()));  // seq_cst publish
+      publish_epoch = epoch.fetch_add(1) + 1;
+
+      if (in_own_read_section()) {
+        retired.push_back(std::move(old));
+        has_retired.store(true, std::memory_order_release);
+        return;
+      }
+    }
+
+    // Never wait while holding writer_mtx, the reader may need it to publish from a callback
+    synchronize(publish_epoch);
+    // old is freed here, outside of any read section that could still see it
+  }
+
+  // Copy of the current value for cold paths on non-reader threads, takes the writer lock
+  T copy() {
+    std::lock_guard<std::mutex> lock(writer_mtx);
+    return *current.load(std::memory_order_relaxed);
+  }
+};
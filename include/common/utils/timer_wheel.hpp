@@ -0,0 +1,338 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Hierarchical timer wheel driven by one service thread, shared by every session of the process
+//
+// LEVELS wheels of SLOTS slots, a slot of level n spans SLOTS^n ticks: a timer goes into the lowest level whose range
+// covers its delay and cascades down as its deadline approaches, so schedule, rearm and cancel are O(1) whatever the
+// delay. The thread sleeps until the next occupied slot (one occupancy word per level), an idle tick costs nothing
+// Timers live in a slab and are named by slot index + generation, a stale id never reaches a reused node
+// Callbacks run on the service thread without the lock, they may schedule, rearm (including their own timer, which
+// fires again after the new delay) or cancel timers. Keep them short, a slow callback delays every other timer
+
+class timer_wheel {
+ public:
+  using clock = std::chrono::steady_clock;
+  using callback = std::function<void()>;
+  using timer_id = uint64_t;  // 0 is never a valid id
+
+  constexpr static auto TICK = std::chrono::milliseconds(1);
+
+ private:
+  constexpr static size_t LEVELS = 4;
+  constexpr static size_t SLOT_BITS = 6;
+  constexpr static size_t SLOTS = size_t{1} << SLOT_BITS;  // 64, one occupancy bit each
+  constexpr static uint64_t SLOT_MASK = SLOTS - 1;
+  constexpr static uint64_t RANGE = uint64_t{1} << (SLOT_BITS * LEVELS);  // ~4.6 h of 1 ms ticks
+  constexpr static uint32_t NIL = UINT32_MAX;
+  constexpr static uint64_t NEVER = UINT64_MAX;
+
+  enum struct timer_state : uint8_t { FREE, PENDING, DUE, RUNNING, REARMED, CANCELLED };
+
+  struct node {
+    uint64_t expires{0};  // tick
+    uint32_t generation{1};
+    uint32_t prev{NIL};
+    uint32_t next{NIL};
+    uint32_t slot{NIL};  // level * SLOTS + index while PENDING
+    timer_state state{timer_state::FREE};
+    callback fn;
+  };
+
+  std::mutex mtx;
+  std::condition_variable wake_cv;     // service thread, a timer earlier than its sleep was scheduled
+  std::condition_variable running_cv;  // cancel() waiting for a running callback
+
+  std::vector<node> nodes;
+  uint32_t free_head;
+  std::array<uint32_t, LEVELS * SLOTS> heads;
+  std::array<uint64_t, LEVELS> occupied;
+  size_t pending;
+
+  clock::time_point origin;
+  uint64_t current;     // next tick to process
+  uint64_t sleep_tick;  // tick the service thread sleeps until, NEVER when idle
+  uint32_t running;     // node whose callback runs right now, NIL otherwise
+  bool stopping;
+  std::thread service_thread;
+
+  static timer_id make_id(uint32_t index, uint32_t generation) {
+    return (static_cast<uint64_t>(generation) << 32) | (index + 1);
+  }
+
+  // Node of a live id, nullptr if it was freed (and maybe reused) since
+  node *lookup(timer_id id) {
+    auto index = static_cast<uint32_t>(id) - 1;
+    if (id == 0 || index >= nodes.size()) return nullptr;
+    auto &n = nodes[index];
+    return n.generation == static_cast<uint32_t>(id >> 32) && n.state != timer_state::FREE ? &n : nullptr;
+  }
+
+  uint64_t now_tick() const {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(clock::now() - origin).count());
+  }
+
+  uint64_t to_tick(clock::duration delay) const {
+    auto ticks = std::chrono::duration_cast<std::chrono::milliseconds>(delay).count();
+    return now_tick() + static_cast<uint64_t>(ticks > 0 ? ticks : 0);
+  }
+
+  uint32_t allocate() {
+    if (free_head == NIL) {
+      nodes.emplace_back();
+      return static_cast<uint32_t>(nodes.size() - 1);
+    }
+    auto index = free_head;
+    free_head = nodes[index].next;
+    return index;
+  }
+
+  void release(uint32_t index) {
+    auto &n = nodes[index];
+    n.state = timer_state::FREE;
+    n.fn = nullptr;
+    ++n.generation;
+    n.next = free_head;
+    free_head = index;
+  }
+
+  void link(uint32_t index) {
+    auto &n = nodes[index];
+    auto expires = n.expires < current ? current : n.expires;
+    auto delta = expires - current;
+
+    auto level = size_t{0};
+    while (level + 1 < LEVELS && delta >= (uint64_t{1} << (SLOT_BITS * (level + 1)))) ++level;
+    auto index_in_level = delta >= RANGE
+                              ? ((current >> (SLOT_BITS * level)) - 1) & SLOT_MASK  // farthest slot, cascades again
+                              : (expires >> (SLOT_BITS * level)) & SLOT_MASK;
+
+    n.slot = static_cast<uint32_t>(level * SLOTS + index_in_level);
+    n.prev = NIL;
+    n.next = heads[n.slot];
+    if (n.next != NIL) nodes[n.next].prev = index;
+    heads[n.slot] = index;
+    occupied[level] |= uint64_t{1} << index_in_level;
+    n.state = timer_state::PENDING;
+    ++pending;
+  }
+
+  void unlink(uint32_t index) {
+    auto &n = nodes[index];
+    if (n.prev != NIL) {
+      nodes[n.prev].next = n.next;
+    } else {
+      heads[n.slot] = n.next;
+    }
+    if (n.next != NIL) nodes[n.next].prev = n.prev;
+    if (heads[n.slot] == NIL) occupied[n.slot / SLOTS] &= ~(uint64_t{1} << (n.slot % SLOTS));
+    n.slot = NIL;
+    --pending;
+  }
+
+  uint32_t take_slot(size_t level, uint64_t index_in_level) {
+    auto slot = level * SLOTS + index_in_level;
+    auto head = heads[slot];
+    for (auto i = head; i != NIL; i = nodes[i].next) nodes[i].slot = NIL;
+    heads[slot] = NIL;
+    occupied[level] &= ~(uint64_t{1} << index_in_level);
+    return head;
+  }
+
+  // First tick at or after current when an occupied slot is processed, NEVER if the wheel is empty
+  uint64_t next_event() const {
+    auto best = NEVER;
+    for (size_t level = 0; level < LEVELS; ++level) {
+      if (!occupied[level]) continue;
+      // Slots of a level are visited every SLOTS^level ticks, in index order
+      auto shift = SLOT_BITS * level;
+      auto step = uint64_t{1} << shift;
+      auto base = (current + step - 1) >> shift << shift;
+      auto start = (base >> shift) & SLOT_MASK;
+      auto rotated = (occupied[level] >> start) | (start ? occupied[level] << (SLOTS - start) : 0);
+      auto tick = base + static_cast<uint64_t>(__builtin_ctzll(rotated)) * step;
+      if (tick < best) best = tick;
+    }
+    return best;
+  }
+
+  // Cascades the higher levels due at tick t, then runs what expires at t; lock held, released around callbacks
+  void process(uint64_t t, std::unique_lock<std::mutex> &lock) {
+    current = t;  // cascaded timers are placed relative to t
+    for (auto level = LEVELS - 1; level > 0; --level) {
+      auto shift = SLOT_BITS * level;
+      if (t & ((uint64_t{1} << shift) - 1)) continue;
+      for (auto i = take_slot(level, (t >> shift) & SLOT_MASK); i != NIL;) {
+        auto next = nodes[i].next;
+        --pending;
+        link(i);
+        i = next;
+      }
+    }
+
+    auto due = take_slot(0, t & SLOT_MASK);
+    for (auto i = due; i != NIL; i = nodes[i].next) {
+      nodes[i].state = timer_state::DUE;  // may still be cancelled or rearmed by an earlier callback
+      --pending;
+    }
+    current = t + 1;  // anything scheduled from a callback lands after this tick
+
+    while (due != NIL) {
+      auto index = due;
+      due = nodes[index].next;
+
+      auto &n = nodes[index];
+      if (n.state == timer_state::CANCELLED) {
+        release(index);
+        continue;
+      }
+      if (n.state == timer_state::REARMED) {
+        link(index);
+        continue;
+      }
+
+      n.state = timer_state::RUNNING;
+      running = index;
+      auto fn = std::move(n.fn);  // nodes may grow while unlocked
+
+      lock.unlock();
+      fn();
+      lock.lock();
+
+      running = NIL;
+      auto &ran = nodes[index];
+      if (ran.state == timer_state::REARMED) {
+        ran.fn = std::move(fn);
+        link(index);
+      } else {
+        release(index);
+      }
+      running_cv.notify_all();
+    }
+  }
+
+  void service() {
+    std::unique_lock<std::mutex> lock(mtx);
+    while (!stopping) {
+      auto now = now_tick();
+
+      // Jump straight to the next occupied slot, empty ticks in between need no work
+      while (!stopping) {
+        auto next = next_event();
+        if (next > now) {
+          current = now + 1 > current ? now + 1 : current;
+          break;
+        }
+        process(next, lock);
+      }
+
+      sleep_tick = next_event();
+      if (sleep_tick == NEVER) {
+        wake_cv.wait(lock);
+      } else {
+        wake_cv.wait_until(lock, origin + sleep_tick * TICK);
+      }
+    }
+  }
+
+ public:
+  timer_wheel()
+      : free_head{NIL},
+        pending{0},
+        origin{clock::now()},
+        current{0},
+        sleep_tick{NEVER},
+        running{NIL},
+        stopping{false} {
+    heads.fill(NIL);
+    occupied.fill(0);
+    service_thread = std::thread([this]() { this->service(); });
+  }
+
+  ~timer_wheel() {
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      stopping = true;
+    }
+    wake_cv.notify_one();
+    if (service_thread.joinable()) service_thread.join();
+  }
+
+  timer_wheel(const timer_wheel &) = delete;
+  timer_wheel &operator=(const timer_wheel &) = delete;
+
+  // The process wide wheel, created on first use
+  static std::shared_ptr<timer_wheel> shared() {
+    static auto instance = std::make_shared<timer_wheel>();
+    return instance;
+  }
+
+  // Runs fn once after delay (rounded down to a tick), a zero delay runs it on the next tick
+  timer_id schedule(clock::duration delay, callback fn) {
+    std::lock_guard<std::mutex> lock(mtx);
+    auto index = allocate();
+    auto &n = nodes[index];
+    n.fn = std::move(fn);
+    n.expires = to_tick(delay);
+    link(index);
+
+    if (n.expires < sleep_tick) wake_cv.notify_one();
+    return make_id(index, n.generation);
+  }
+
+  // Moves the deadline to delay from now, false if the timer already fired or was cancelled
+  // From its own callback, the timer fires again after delay
+  bool rearm(timer_id id, clock::duration delay) {
+    std::lock_guard<std::mutex> lock(mtx);
+    auto n = lookup(id);
+    if (!n || n->state == timer_state::CANCELLED) return false;
+
+    n->expires = to_tick(delay);
+    if (n->state == timer_state::PENDING) {
+      unlink(static_cast<uint32_t>(n - nodes.data()));
+      link(static_cast<uint32_t>(n - nodes.data()));
+    } else {
+      n->state = timer_state::REARMED;  // due or running, relinked once processed
+    }
+
+    if (n->expires < sleep_tick) wake_cv.notify_one();
+    return true;
+  }
+
+  // Drops the timer, false if it already fired; a callback running on another thread is waited for, so whatever
+  // it captured can be destroyed once this returns
+  bool cancel(timer_id id) {
+    std::unique_lock<std::mutex> lock(mtx);
+    auto n = lookup(id);
+    if (!n || n->state == timer_state::CANCELLED) return false;
+
+    auto index = static_cast<uint32_t>(n - nodes.data());
+    if (n->state == timer_state::PENDING) {
+      unlink(index);
+      release(index);
+      return true;
+    }
+
+    n->state = timer_state::CANCELLED;  // due or running, freed once processed
+    if (std::this_thread::get_id() != service_thread.get_id()) {
+      running_cv.wait(lock, [this, index] { return running != index; });
+    }
+    return true;
+  }
+
+  size_t size() {
+    std::lock_guard<std::mutex> lock(mtx);
+    return pending;
+  }
+};
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Bounded single-producer / single-consumer queue of Annex-B access units in preallocated buffers
+//
+// The producer (a track's depacketizer) fills a frame in place and commits it, the consumer reads the same
+// buffer through a lease and hands it back by dropping the lease: no copy and no allocation per frame
+// Full queue means the producer drops the new frame, a slow consumer never stalls the network thread
+// The consumer may hold several leases, each pins its frame until released; leases are released in the order they
+// were taken
+
+struct frame {
+  std::unique_ptr<uint8_t[]> data;
+  size_t capacity{0};
+  size_t size{0};
+  uint32_t rtp_timestamp{0};
+  int64_t rx_time_ns{0};  // arrival of the first packet, steady clock
+  bool is_keyframe{false};
+  bool is_reference{false};  // other frames may predict from it (nal_ref_idc != 0)
+  bool sampled{true};        // picked by the ingest policy, false if only decoded to keep the chain intact
+};
+
+class frame_queue {
+ public:
+  class lease {
+   private:
+    frame_queue *owner;
+    const frame *item;
+
+   public:
+    lease() : owner{nullptr}, item{nullptr} {}
+    lease(frame_queue *owner, const frame *item) : owner{owner}, item{item} {}
+    lease(lease &&other) noexcept : owner{other.owner}, item{other.item} { other.owner = nullptr; }
+    lease &operator=(lease &&other) noexcept;
+    lease(const lease &) = delete;
+    lease &operator=(const lease &) = delete;
+    ~lease() { release(); }
+
+    void release();
+
+    explicit operator bool() const { return owner != nullptr; }
+    const frame &operator*() const { return *item; }
+    const frame *operator->() const { return item; }
+  };
+
+ private:
+  std::vector<frame> frames;  // power of two
+  size_t mask;
+
+  alignas(64) std::atomic<size_t> head;  // next frame the producer fills
+  alignas(64) std::atomic<size_t> tail;  // oldest frame still leased or unread, the producer's limit
+  size_t next_read;                       // next frame the consumer leases, consumer only
+
+  // Only used when the consumer sleeps on an empty queue
+  std::mutex wait_mtx;
+  std::condition_variable wait_cv;
+  std::atomic<bool> waiting;
+
+  std::function<void()> on_commit;  // wakes a consumer that polls several queues, set once at construction
+
+  void advance_tail() { tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+ public:
+  // count is rounded up to a power of two, frame_capacity is the largest access unit the queue can carry
+  frame_queue(size_t count, size_t frame_capacity, std::function<void()> on_commit = nullptr);
+
+  frame_queue(const frame_queue &) = delete;
+  frame_queue &operator=(const frame_queue &) = delete;
+
+  // Producer side, returns the frame to fill or nullptr when full; the frame is invisible until commit()
+  frame *begin_write();
+  void commit();
+
+  // Consumer side, an empty lease when nothing is ready
+  lease try_pop();
+  lease pop(std::chrono::milliseconds timeout);
+
+  size_t get_capacity() const { return frames.size(); }
+};
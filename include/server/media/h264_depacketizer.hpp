@@ -0,0 +1,151 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "common/rtp/rtp_view.hpp"
+#include "server/media/frame_queue.hpp"
+#include "server/media/ingest_policy.hpp"
+
+// Receive pipeline stage of one video track: RTP in, complete H.264 access units out
+//
+// Packets are reordered by sequence number in a fixed window, a packet that arrives in order (the common case)
+// is assembled straight from the network buffer, only out-of-order packets are copied into the window
+// The window is an adaptive jitter buffer: missing packets are NACKed right away and re-NACKed a few times,
+// a hole is waited for as long as the current wait budget and counted as lost after that
+// The budget follows the measured interarrival jitter and retransmission delay, bounded by the profile
+//
+// FU-A fragments and STAP-A aggregates are reassembled into an Annex-B access unit written in place into the
+// frame queue; access units with a hole are dropped since a decoder cannot use them, and a keyframe is
+// requested (PLI). Frames that reference a lost one can be held back until that keyframe arrives
+// Complete access units pass the ingest policy before they are committed, so unsampled frames never take a slot
+// Not thread safe, push() runs on the track's libdatachannel thread, stats can be read from anywhere
+
+// Trade-off between latency and frame completeness
+struct jitter_profile {
+  int64_t min_wait_ms;        // budget floor for a hole, 0 gives up as soon as the budget allows
+  int64_t max_wait_ms;        // budget ceiling, bounds the latency a hole can add
+  uint32_t max_nacks;         // requests per missing packet, 0 disables NACK
+  bool drop_until_keyframe;   // hold back frames whose references were lost
+
+  static constexpr jitter_profile low_latency() { return {0, 20, 1, false}; }
+  static constexpr jitter_profile balanced() { return {10, 80, 2, true}; }
+  static constexpr jitter_profile complete() { return {30, 250, 4, true}; }
+};
+
+class h264_depacketizer {
+ public:
+  struct stats {
+    uint64_t packets;
+    uint64_t lost;               // never arrived within the wait budget
+    uint64_t late;               // arrived after their slot was given up on, or duplicates
+    uint64_t reordered;          // arrived out of order but in time
+    uint64_t recovered;          // arrived in time after a NACK
+    uint64_t nacks;              // sequence numbers requested
+    uint64_t keyframe_requests;  // PLIs sent
+    uint64_t frames;             // access units delivered
+    uint64_t frames_damaged;     // dropped because of a hole or an oversized access unit
+    uint64_t frames_skipped;     // held back while waiting for a keyframe
+    uint64_t frames_dropped;     // dropped because the consumer fell behind
+    uint64_t frames_filtered;    // not admitted by the ingest policy
+    int64_t wait_budget_us;      // current hole wait budget
+    int64_t jitter_us;           // interarrival jitter estimate (RFC 3550)
+  };
+
+  // Invoked from push(), seqs are ascending and only valid during the call
+  struct feedback {
+    std::function<void(uint32_t media_ssrc, const uint16_t *seqs, size_t count)> send_nack;
+    std::function<void()> request_keyframe;
+  };
+
+ private:
+  constexpr static size_t WINDOW = 128;           // power of two, largest reordering distance tolerated
+  constexpr static size_t SLOT_SIZE = 1500;       // RTP over a typical MTU
+  constexpr static uint32_t CLOCK_RATE = 90000;   // H.264 RTP clock
+  constexpr static int64_t KEYFRAME_REQUEST_INTERVAL_NS = 300'000'000;  // PLI rate limit
+  constexpr static int64_t NACK_RETRY_FLOOR_NS = 5'000'000;             // never re-NACK faster than this
+
+  struct slot {
+    bool used{false};     // packet buffered
+    bool missing{false};  // known hole, NACK state below
+    uint16_t seq{0};
+    size_t len{0};
+    int64_t rx_time_ns{0};
+    int64_t first_missing_ns{0};
+    int64_t last_nack_ns{0};
+    uint32_t nacks{0};
+    std::array<uint8_t, SLOT_SIZE> data;
+  };
+
+  uint8_t payload_type;
+  jitter_profile profile;
+  std::shared_ptr<frame_queue> frames;
+  feedback fb;
+  ingest_policy ingest;
+
+  std::unique_ptr<std::array<slot, WINDOW>> window;
+  size_t buffered;
+  bool has_expected;
+  uint16_t expected;  // next sequence number to assemble
+  uint16_t highest;   // newest sequence number seen
+  bool pending_gap;   // packets before the next assembled one were lost
+  uint32_t media_ssrc;
+  std::vector<uint16_t> nack_list;  // reused, never grows past WINDOW
+
+  // Adaptive wait budget, all in nanoseconds
+  int64_t jitter_ns;
+  int64_t recovery_ns;  // smoothed NACK to retransmission delay
+  int64_t last_transit_ns;
+  bool has_transit;
+
+  // Access unit being assembled, nullptr while skipping one that is dropped
+  frame *current;
+  bool in_access_unit;
+  bool damaged;
+  bool in_fragment;
+  uint32_t current_timestamp;
+
+  bool awaiting_keyframe;
+  std::atomic<bool> consumed;  // the queue has a reader, set from other threads
+  bool was_consumed;           // network thread's last view of it, a resume asks for a keyframe
+  int64_t last_keyframe_request_ns;
+  int64_t now_ns;  // arrival time of the packet being pushed
+
+  std::atomic<uint64_t> packets, lost, late, reordered, recovered, nacks, keyframe_requests;
+  std::atomic<uint64_t> delivered, damaged_frames, skipped_frames, dropped_frames, filtered_frames;
+  std::atomic<int64_t> budget_ns;
+
+  void assemble(const rtp_view &rtp, int64_t rx_time_ns);
+  void begin_access_unit(uint32_t timestamp, int64_t rx_time_ns);
+  void end_access_unit();
+  void append_nal(const uint8_t *nal, size_t len);
+  void append(const uint8_t *data, size_t len);
+
+  void drain();
+  void skip_hole();
+  void reset_window();
+
+  void update_jitter(const rtp_view &rtp, int64_t rx_time_ns);
+  void note_arrival(slot &s, uint16_t seq, int64_t rx_time_ns);
+  void mark_missing(uint16_t from, uint16_t to);
+  void service_holes();
+  void request_keyframe();
+
+ public:
+  h264_depacketizer(uint8_t payload_type, std::shared_ptr<frame_queue> frames,
+                    jitter_profile profile = jitter_profile::balanced(), feedback fb = {},
+                    ingest_config ingest = ingest_config::all());
+
+  void push(const void *data, size_t len, int64_t rx_time_ns);
+
+  // Access units only reach the queue while someone reads it, without a reader they are dropped quietly
+  // instead of filling the queue and asking for keyframes nobody decodes
+  void set_consumed(bool value) { consumed.store(value, std::memory_order_relaxed); }
+
+  stats get_stats() const;
+};
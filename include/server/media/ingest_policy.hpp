@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+
+#include "server/media/frame_queue.hpp"
+
+// Decides which access units of a track reach the decoder, facial recognition does not need every frame
+//
+// A P frame can only be decoded if every reference frame since the last IDR was, so sampling follows the
+// reference chain: with decode_references, reference frames between samples are still passed on (marked as not
+// sampled, the consumer decodes them but skips recognition) and only non-reference frames are saved; without it,
+// the first dropped reference breaks the chain and sampling resumes at the next IDR, optionally requested early
+// Runs on the depacketizer's thread, not thread safe
+
+enum struct ingest_mode {
+  ALL,             // every frame is sampled
+  KEYFRAMES_ONLY,  // IDR frames only, each one decodes on its own
+  EVERY_NTH,       // one frame out of rate
+  MAX_FPS          // at most rate frames per second of stream time
+};
+
+struct ingest_config {
+  ingest_mode mode;
+  uint32_t rate;           // N for EVERY_NTH, frames per second for MAX_FPS
+  bool decode_references;  // keep the reference chain decodable between samples
+  bool request_keyframes;  // ask for an IDR when a sample is due but its chain was dropped
+
+  static constexpr ingest_config all() { return {ingest_mode::ALL, 0, true, false}; }
+  static constexpr ingest_config keyframes_only(bool request_keyframes = false) {
+    return {ingest_mode::KEYFRAMES_ONLY, 0, false, request_keyframes};
+  }
+  // References are decoded by default: the robot relays an external camera stream and cannot force an IDR, so
+  // without them sampling would fall back to the stream's own keyframes
+  static constexpr ingest_config every_nth(uint32_t n, bool decode_references = true) {
+    return {ingest_mode::EVERY_NTH, n, decode_references, !decode_references};
+  }
+  static constexpr ingest_config max_fps(uint32_t fps, bool decode_references = true) {
+    return {ingest_mode::MAX_FPS, fps, decode_references, !decode_references};
+  }
+};
+
+class ingest_policy {
+ public:
+  enum struct decision {
+    DROP,       // never reaches the decoder
+    REFERENCE,  // decoded only to keep later samples decodable
+    SAMPLE      // decoded and recognized
+  };
+
+ private:
+  constexpr static uint32_t CLOCK_RATE = 90000;  // H.264 RTP clock
+
+  ingest_config config;
+  uint32_t interval;  // MAX_FPS sampling period in RTP ticks
+
+  bool chain_intact;   // every reference frame since the last IDR went to the decoder
+  bool has_sampled;
+  uint32_t since_sample;  // frames since the last sample, EVERY_NTH
+  uint32_t next_due;      // RTP timestamp of the next sample, MAX_FPS
+  bool keyframe_wanted;
+
+  bool is_due(const frame &f) const;
+  void sampled(const frame &f);
+
+ public:
+  explicit ingest_policy(ingest_config config);
+
+  // Called for every complete access unit before it is committed to the frame queue
+  decision admit(const frame &f);
+
+  // A frame was lost before reaching the policy, later frames may reference it
+  void break_chain() { chain_intact = false; }
+
+  // True once after admit() found a due sample undecodable and the config asks for a keyframe
+  bool take_keyframe_request();
+};
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <rtc/rtc.hpp>
+#include <vector>
+
+// Media handler that sends the receiver's own RTCP feedback (NACKs) back to the sender
+//
+// A RecvOnly track drops anything sent through Track::send() that is not a Control message, so feedback has to
+// leave through the handler chain like the PLI of RtcpReceivingSession does. Packets queued from the depacketizer
+// go out as Control messages with the next inbound batch, a packet or so later
+class rtcp_feedback_sender final : public rtc::MediaHandler {
+ private:
+  constexpr static size_t MAX_PENDING = 16;  // feedback older than this many packets is stale, the rest is dropped
+
+  std::mutex mtx;
+  std::vector<rtc::binary> pending;
+  std::atomic<bool> has_pending{false};  // keeps the lock off the packet path when there is nothing to send
+
+ public:
+  // Any thread, false if too much feedback is already waiting
+  bool queue(rtc::binary packet);
+
+  void incoming(rtc::message_vector &messages, const rtc::message_callback &send) override;
+};
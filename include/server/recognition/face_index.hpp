@@ -0,0 +1,115 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "server/recognition/face_segment.hpp"
+#include "server/recognition/recognition_backend.hpp"
+
+// Similarity index of face embeddings, answers "have we seen this face" with a brute force top-k scan
+//
+// Rows live in append-only face segments, either float32 or int8 (4x smaller, embeddings are L2-normalized so a
+// fixed 1/127 scale loses little); the dot-product kernels are picked once at construction: AVX-512, AVX2 or scalar
+// With a directory the segments are files: construction maps the existing ones without reading them, so a restart
+// serves the warm index right away and the kernel pages it in as searches touch it. Without one they are anonymous
+// Each identity expires TTL after it was inserted or last refreshed; expired rows are skipped by search() and
+// reclaimed by a background compaction that rewrites sparse sealed segments and merges small ones
+// Used from one thread (the recognition scheduler), the mutex only orders it against the compaction thread
+// A directory belongs to one process at a time (flock on LOCK). Another one finding it taken (a rolling deployment)
+// maps its segments read-only and keeps new identities in memory, then retries the lock from the compaction thread
+// and, once the old process exits, takes the store over and persists what it gathered meanwhile
+
+class face_index {
+ public:
+  struct match {
+    uint64_t id;
+    float score;  // cosine similarity
+    const face_segment *segment;  // location hint for refresh()
+    size_t row;
+  };
+
+ private:
+  constexpr static float INT8_SCALE = 127.0f;
+  constexpr static float COMPACTION_LIVE_RATIO = 0.5f;  // rewrite a sealed segment once half of it expired
+  constexpr static const char *SEGMENT_SUFFIX = ".seg";
+  constexpr static const char *LOCK_FILE = "LOCK";  // flock'd by the process that owns the directory
+  constexpr static auto LOCK_RETRY_INTERVAL = std::chrono::seconds(5);
+
+  using f32_kernel = void (*)(const float *matrix, size_t rows, const float *query, float *scores);
+  using i8_kernel = void (*)(const int8_t *matrix, size_t rows, const int8_t *query, float *scores);
+
+  index_precision precision;
+  uint32_t segment_capacity;
+  int64_t ttl_ns;
+  std::string directory;  // empty when nothing is persisted
+
+  mutable std::mutex mtx;
+  std::vector<std::shared_ptr<face_segment>> segments;  // the last one takes appends
+  bool owns_store;  // holds LOCK, without it new segments are anonymous; written by the compaction thread
+  uint64_t next_id;
+  std::atomic<uint64_t> next_sequence;
+
+  f32_kernel score_f32;
+  i8_kernel score_i8;
+  const char *kernel_name;
+
+  mutable std::vector<float> scores;    // scratch, one per row of the largest segment
+  mutable std::vector<int8_t> query_i8;  // scratch, quantized query
+  std::vector<int8_t> row_i8;            // scratch, quantized insert
+
+  // Compaction, woken by evict_expired()
+  std::mutex compaction_mtx;
+  std::condition_variable compaction_cv;
+  bool compaction_requested;
+  bool stopping;
+  int64_t compaction_now_ns;
+  std::thread compaction_thread;
+
+  int lock_fd;  // holds the store's lock, -1 without a directory
+
+  bool lock_store();
+  void load();
+  std::vector<std::shared_ptr<face_segment>> map_store(bool read_only);
+  void take_over_store();
+  std::string segment_path(uint64_t sequence) const;
+  std::shared_ptr<face_segment> new_segment();
+  uint64_t append(int64_t expires_ns, const void *row);
+  void score_segment(const face_segment &segment, size_t rows, const float *query) const;
+
+  void compaction_loop();
+  void compact(int64_t now_ns);
+
+ public:
+  // capacity is the number of rows per segment, directory is created if missing
+  face_index(index_precision precision, size_t capacity, int64_t ttl_ns, std::string directory = {});
+  ~face_index();
+
+  face_index(const face_index &) = delete;
+  face_index &operator=(const face_index &) = delete;
+
+  // Adds an identity, allocation-free until the current segment fills up, returns its id or 0 if it could not be
+  // stored (a new segment could not be created)
+  uint64_t insert(const float *embedding, int64_t now_ns);
+
+  // Extends the lifetime of a matched identity, false if it is gone
+  bool refresh(const match &found, int64_t now_ns);
+
+  // Best k live identities by similarity, highest first, returns how many were written to out
+  size_t search(const float *query, size_t k, match *out, int64_t now_ns) const;
+
+  // Counts expired rows and hands sparse segments to the background compaction, returns the expired count
+  size_t evict_expired(int64_t now_ns);
+
+  // Rows held, including expired ones not compacted yet
+  size_t size() const;
+  size_t segment_count() const;
+  const char *get_kernel() const { return kernel_name; }
+};
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "server/recognition/recognition_backend.hpp"
+
+// One append-only block of face embeddings, the unit of persistence of the face index
+//
+// A segment is a single memory-mapped file (or an anonymous mapping when nothing is persisted) laid out as
+//   [header, 4 KiB][ids, capacity x u64][expiries, capacity x i64][rows, capacity x EMBEDDING_DIM x element]
+// so the index scans the mapping in place: opening a segment reads only its header and pages come in on first use
+// Records are appended at count, which is published after the record, so a crash never exposes a torn one
+// Expiry is the only field updated in place (refresh), everything else is immutable once published
+// Sealed segments are never appended to again, the background compaction rewrites them without their dead rows
+// A read-only segment (a file another process owns) leaves its file untouched: appends fail, seal/rename/remove/flush
+// do nothing, and expiries refreshed here stay private to this process
+
+enum struct index_precision { FLOAT32, INT8 };
+
+class face_segment {
+ public:
+  constexpr static uint64_t MAGIC = 0x3147455345434146;  // "FACESEG1"
+  constexpr static uint32_t VERSION = 1;
+  constexpr static size_t HEADER_SIZE = 4096;  // keeps the arrays page (and SIMD) aligned
+
+ private:
+  struct header {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t dim;
+    uint32_t precision;
+    uint32_t capacity;
+    uint64_t sequence;  // creation order, names the file
+    alignas(64) std::atomic<uint32_t> count;
+    std::atomic<uint32_t> sealed;
+    std::atomic<uint64_t> max_id;
+  };
+
+  std::string path;  // empty for an anonymous segment
+  int fd;
+  bool read_only;
+  uint8_t *mapping;
+  size_t mapping_size;
+  size_t row_size;
+
+  header *hdr;
+  uint64_t *ids;
+  int64_t *expiries;
+  uint8_t *rows;
+
+  face_segment();
+  void map(size_t capacity);
+
+ public:
+  face_segment(const face_segment &) = delete;
+  face_segment &operator=(const face_segment &) = delete;
+  ~face_segment();
+
+  // New empty segment, file-backed when path is not empty, throws if it cannot be created
+  static auto create(const std::string &path, index_precision precision, uint32_t capacity, uint64_t sequence)
+      -> std::unique_ptr<face_segment>;
+
+  // Maps an existing segment without reading its records, nullptr if the file has another layout or version,
+  // throws if it cannot be opened or mapped
+  static auto open(const std::string &path, index_precision precision, bool read_only = false)
+      -> std::unique_ptr<face_segment>;
+
+  // Writer side, false once the segment is full, sealed or read-only; row holds EMBEDDING_DIM elements of the precision
+  bool append(uint64_t id, int64_t expires_ns, const void *row);
+  void seal();
+
+  // Moves the backing file, used to publish a compacted segment atomically
+  void rename(const std::string &new_path);
+
+  // Unlinks the backing file, the mapping stays readable until the segment is destroyed
+  void remove();
+
+  // Starts writeback of dirty pages, a crash of the process loses nothing even without it
+  void flush() const;
+
+  size_t size() const { return hdr->count.load(std::memory_order_acquire); }
+  size_t capacity() const { return hdr->capacity; }
+  bool is_sealed() const { return hdr->sealed.load(std::memory_order_acquire) != 0; }
+  bool is_read_only() const { return read_only; }
+  uint64_t get_sequence() const { return hdr->sequence; }
+  uint64_t get_max_id() const { return hdr->max_id.load(std::memory_order_relaxed); }
+  const std::string &get_path() const { return path; }
+
+  uint64_t id(size_t row) const { return ids[row]; }
+  int64_t expiry(size_t row) const { return __atomic_load_n(&expiries[row], __ATOMIC_RELAXED); }
+  void set_expiry(size_t row, int64_t expires_ns) { __atomic_store_n(&expiries[row], expires_ns, __ATOMIC_RELAXED); }
+
+  const void *row(size_t row) const { return rows + row * row_size; }
+  const float *f32_rows() const { return reinterpret_cast<const float *>(rows); }
+  const int8_t *i8_rows() const { return reinterpret_cast<const int8_t *>(rows); }
+};
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "server/recognition/face_index.hpp"
+#include "server/recognition/recognition_backend.hpp"
+
+// Remembers who was greeted recently: a face close enough to a remembered one counts as greeted and keeps that
+// identity alive, any other face is remembered from now on. Identities are forgotten GREETING_TTL after they were
+// last seen, so someone coming back the next day is greeted again
+// The identities persist in face segments under a directory, a restarted server keeps greeting from where it was;
+// expiries are wall clock for that reason
+// Plugged into the recognition scheduler as its greeting resolver, runs on the scheduler thread only
+
+class greeting_registry {
+ private:
+  constexpr static float MATCH_THRESHOLD = 0.6f;                       // cosine similarity of the same person
+  constexpr static int64_t GREETING_TTL_NS = 4 * 3600 * 1'000'000'000LL;  // one shift
+  constexpr static int64_t EVICTION_INTERVAL_NS = 1'000'000'000;
+  constexpr static size_t SEGMENT_CAPACITY = 16384;  // rows per segment file, 2.3 MB at int8
+
+  face_index index;
+  int64_t next_eviction_ns;
+
+ public:
+  // Empty directory keeps the identities in memory only
+  explicit greeting_registry(const std::string &directory);
+
+  // True if the face was greeted before, the face counts as greeted from now on either way
+  bool resolve(const std::string &session_id, const recognition_output &result);
+
+  size_t size() const { return index.size(); }
+  size_t segment_count() const { return index.segment_count(); }
+};
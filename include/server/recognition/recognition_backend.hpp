@@ -0,0 +1,55 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "server/media/frame_queue.hpp"
+
+// Pluggable facial recognition model, fed whole batches by the recognition scheduler
+// Inputs are H.264 access units in decode order per session, decoding is part of the backend since it owns the
+// decoder state; frames with sampled == false only advance that state and produce no result
+// Called from the scheduler thread only
+
+constexpr size_t EMBEDDING_DIM = 128;
+
+struct recognition_input {
+  const std::string *session_id;  // robot session the frame belongs to, one decoder state per session
+  const frame *image;
+};
+
+struct recognition_output {
+  bool has_face{false};
+  bool greeted{false};  // face matches someone already greeted, filled in after the model by the scheduler
+  float confidence{0.0f};
+  std::array<float, EMBEDDING_DIM> embedding{};  // L2-normalized
+};
+
+class recognition_backend {
+ public:
+  virtual ~recognition_backend() = default;
+
+  // Largest batch the model takes in one call
+  virtual size_t max_batch() const = 0;
+
+  // outputs[i] belongs to inputs[i], count <= max_batch()
+  virtual void infer(const recognition_input *inputs, size_t count, recognition_output *outputs) = 0;
+};
+
+// Stand-in model for tests and machines without the real one: sees one face per session on every sampled frame,
+// whose embedding is derived from the session id, and burns a configurable amount of time like a real batch would
+class cpu_stub_backend final : public recognition_backend {
+ private:
+  size_t batch_limit;
+  std::chrono::microseconds batch_cost;  // fixed overhead per infer() call
+  std::chrono::microseconds frame_cost;  // added per frame of the batch
+
+ public:
+  explicit cpu_stub_backend(size_t batch_limit = 16, std::chrono::microseconds batch_cost = std::chrono::microseconds{0},
+                            std::chrono::microseconds frame_cost = std::chrono::microseconds{0});
+
+  size_t max_batch() const override { return batch_limit; }
+  void infer(const recognition_input *inputs, size_t count, recognition_output *outputs) override;
+};
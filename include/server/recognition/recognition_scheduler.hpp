@@ -0,0 +1,96 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "server/media/frame_queue.hpp"
+#include "server/recognition/recognition_backend.hpp"
+
+// Server-wide batching in front of the recognition backend
+//
+// Every bound track registers its frame queue as a source; one scheduler thread takes frames round robin, one per
+// source per pass so a busy robot cannot starve the others, as long as any are ready, and runs the batch once it is
+// full or once its oldest frame has waited BATCH_DEADLINE, which bounds the added latency when only a few robots stream
+// Commits on any source wake the scheduler through notify(), an idle scheduler sleeps
+
+using namespace std::chrono_literals;
+
+class recognition_scheduler {
+ public:
+  // Invoked on the scheduler thread for every sampled frame, returning false unregisters the source
+  using result_callback = std::function<bool(const recognition_output &)>;
+
+  // Decides greeted for a detected face, nothing counts as greeted until one is set
+  using greeting_resolver = std::function<bool(const std::string &session_id, const recognition_output &)>;
+
+ private:
+  constexpr static auto BATCH_DEADLINE = 25ms;  // latency budget for a partial batch
+  constexpr static auto IDLE_WAIT = 1s;         // upper bound on a sleep with nothing pending
+
+  struct source {
+    uint64_t id;
+    std::string session_id;
+    std::shared_ptr<frame_queue> frames;
+    result_callback on_result;
+    bool active{true};  // guarded by mtx, cleared on removal so no callback runs afterwards
+  };
+
+  struct entry {
+    std::shared_ptr<source> src;
+    frame_queue::lease image;
+  };
+
+  std::unique_ptr<recognition_backend> backend;
+  greeting_resolver resolve_greeting;
+
+  std::mutex mtx;  // protects sources and is held while results are delivered
+  std::vector<std::shared_ptr<source>> sources;
+  uint64_t next_id;
+  bool sources_changed;
+
+  std::mutex wake_mtx;
+  std::condition_variable wake_cv;
+  std::atomic<bool> pending;   // a source committed a frame since the last scan
+  std::atomic<bool> sleeping;  // the scheduler waits on wake_cv
+
+  std::thread scheduler_thread;
+  std::atomic<bool> is_running;
+  std::atomic<uint64_t> batches, frames_run;
+
+  void schedule_work();
+  void run_batch(std::vector<entry> &batch, std::vector<recognition_input> &inputs,
+                 std::vector<recognition_output> &outputs);
+
+ public:
+  recognition_scheduler() = delete;
+  recognition_scheduler(const recognition_scheduler &) = delete;
+  recognition_scheduler &operator=(const recognition_scheduler &) = delete;
+
+  explicit recognition_scheduler(std::unique_ptr<recognition_backend> backend);
+  ~recognition_scheduler();
+
+  // The scheduler becomes the queue's single consumer until the source is removed
+  uint64_t add_source(const std::string &session_id, std::shared_ptr<frame_queue> frames, result_callback on_result);
+
+  // No callback of the source runs once this returns, unless called from a result callback
+  void remove_source(uint64_t id);
+
+  // Must be set before the first source is added
+  void set_greeting_resolver(greeting_resolver resolver) { resolve_greeting = std::move(resolver); }
+
+  // Called by producers after a commit, cheap when the scheduler is busy
+  void notify();
+
+  void stop();
+
+  uint64_t get_batches() const { return batches.load(std::memory_order_relaxed); }
+  uint64_t get_frames() const { return frames_run.load(std::memory_order_relaxed); }
+};
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <grpcpp/grpcpp.h>
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "common/utils/timer_wheel.hpp"
+#include "grpc/robot.grpc.pb.h"
+
+// gRPC channels to the robots of the fleet, keyed by the address their robot_service listens on
+//
+// A channel is created on first use and then kept connected: HTTP/2 keepalive pings hold it open through NATs
+// and notice a dead robot, and a health check on the shared timer wheel reconnects a channel that dropped, so a
+// server to robot call finds a ready connection. Channels unused for IDLE_TIMEOUT, or failing for
+// MAX_FAILED_CHECKS checks in a row, are evicted; stubs already handed out keep their channel alive until released
+// The robot's listener has to accept pings every KEEPALIVE_TIME without calls (min ping interval, ping strikes)
+// The host always comes from the call's peer, a robot can only name its own port; past MAX_ROBOTS the least
+// recently used channel is evicted so a flood of addresses cannot grow the registry without bound
+
+class robot_registry {
+ public:
+  using stub_ptr = std::shared_ptr<robot::robot_service::Stub>;
+
+  constexpr static int ROBOT_PORT = 6002;                     // robot_service port when the robot does not say
+  constexpr static const char *ADDRESS_METADATA = "robot-address";  // optional, "host:port" or "port", peer's host
+
+ private:
+  constexpr static auto IDLE_TIMEOUT = std::chrono::minutes(10);
+  constexpr static auto HEALTH_INTERVAL = std::chrono::seconds(15);
+  constexpr static int KEEPALIVE_TIME_MS = 20'000;
+  constexpr static int KEEPALIVE_TIMEOUT_MS = 5'000;
+  constexpr static uint32_t MAX_FAILED_CHECKS = 4;  // a minute unreachable
+  constexpr static size_t MAX_ROBOTS = 1024;
+
+  struct robot_channel {
+    std::shared_ptr<grpc::Channel> channel;
+    stub_ptr stub;
+    int64_t last_used_ns{0};  // steady clock
+    uint32_t failed_checks{0};
+    grpc_connectivity_state last_state{GRPC_CHANNEL_IDLE};
+    timer_wheel::timer_id health_timer{0};
+  };
+
+  std::shared_ptr<timer_wheel> timers;
+  std::mutex mtx;  // acquire() only runs on session setup, a plain map is enough for a fleet
+  std::unordered_map<std::string, robot_channel> channels;
+
+  // Timer callback, reconnects or evicts the channel
+  void check_health(const std::string &address);
+
+ public:
+  robot_registry();
+  ~robot_registry();
+
+  robot_registry(const robot_registry &) = delete;
+  robot_registry &operator=(const robot_registry &) = delete;
+
+  // Stub for the robot at address, reusing its warm channel when there is one
+  stub_ptr acquire(const std::string &address);
+
+  // Where the robot behind a call listens: its peer host, on the port of its robot-address metadata or ROBOT_PORT
+  static std::string address_of(const grpc::ServerContextBase &context);
+
+  size_t size();
+};
@@ -2,34 +2,81 @@
 #include <grpcpp/grpcpp.h>
 #include <quill/Logger.h>
 
+#include <chrono>
+#include <condition_variable>
 #include <functional>
 #include <memory>
 #include <mutex>
 #include <rtc/rtc.hpp>
+#include <thread>
+#include <vector>
 
 #include "common/chat_type.hpp"
 #include "grpc/robot.grpc.pb.h"
 #include "grpc/server.grpc.pb.h"
 #include "common/sessions/base_session.hpp"
+#include "common/sessions/session_table.hpp"
+#include "common/utils/timer_wheel.hpp"
+#include "server/recognition/greeting_registry.hpp"
+#include "server/recognition/recognition_backend.hpp"
+#include "server/recognition/recognition_scheduler.hpp"
+#include "server/rpc/robot_registry.hpp"
+#include "server/sessions/camera_receiver.hpp"
 
-class server_rpc_manager final : public server::server_service::Service {
+// Callback API service, handlers return immediately and complete their reactor later
+// so a pending offer does not hold a server thread while ICE gathering runs
+class server_rpc_manager final : public server::server_service::CallbackService {
  private:
   constexpr static size_t MAX_SESSIONS = 10;
-  std::shared_ptr<grpc::Channel> channel;
-  std::shared_ptr<robot::robot_service::Stub> stub;
+  constexpr static auto RECLAIM_INTERVAL = std::chrono::seconds(10);  // backstop, sessions report going inactive
+  robot_registry robots;  // warm channels to every robot that streams to this server
+  ingest_config ingest;  // frame sampling of every new session
+  std::shared_ptr<greeting_registry> greetings;      // used by the scheduler thread only
+  std::shared_ptr<recognition_scheduler> scheduler;  // batches frames of every session, outlives them
 
-  std::unordered_map<std::string, std::shared_ptr<base_session>> sessions;
-  mutable std::mutex mtx;  // mutex for the sessions map
+  // Every session has a reclaim timer on the shared wheel, fired right away when the session goes inactive
+  struct session_entry {
+    std::shared_ptr<base_session> session;
+    timer_wheel::timer_id reclaim_timer;
+  };
 
-  std::thread periodic_thread;
-  std::atomic<bool> is_running;
+  std::shared_ptr<timer_wheel> timers;
+  session_table<session_entry> sessions{MAX_SESSIONS};  // sharded, sessions are built outside its locks
 
-  void cleanup_sessions();
+  // Publishes a session built under a reservation and arms its reclaim timer, false if the id is taken
+  bool add_session(session_table<session_entry>::reservation&& slot, const std::string& session_id,
+                   std::shared_ptr<base_session> session);
+
+  // Reclaimed sessions are released here rather than on the shared wheel thread, closing a PeerConnection can
+  // block and would hold up every timer of the process
+  std::mutex reaper_mtx;
+  std::condition_variable reaper_cv;
+  std::vector<std::shared_ptr<base_session>> reaped;
+  bool reaper_stopping{false};
+  std::thread reaper_thread;
+
+  // Timer callback, drops the session if it went inactive
+  void reclaim_session(const std::string& session_id);
+  void reaper_loop();
+
+  // The receiver of a live session, nullptr if there is none; an inactive one is erased first
+  std::shared_ptr<camera_receiver> find_session(const std::string& session_id);
+
+  // Registers a receiver for a new session of the robot at robot_address, nullptr with status set when the
+  // session cannot be created; a live session under the same id is returned if reuse is set, rejected otherwise
+  std::shared_ptr<camera_receiver> create_session(const std::string& session_id, const std::string& robot_address,
+                                                  bool reuse, grpc::Status& status);
 
  public:
-  server_rpc_manager();
+  // face_store_dir keeps the greeted identities across restarts, empty keeps them in memory only
+  server_rpc_manager(std::unique_ptr<recognition_backend> backend, const std::string& face_store_dir,
+                     ingest_config ingest = ingest_config::all());
   ~server_rpc_manager() override;
 
-  grpc::Status init_camera_stream(grpc::ServerContext* context, const server::init_camera_offer* request,
-                                  server::init_camera_answer* response) override;
+  grpc::ServerUnaryReactor* init_camera_stream(grpc::CallbackServerContext* context,
+                                               const server::init_camera_offer* request,
+                                               server::init_camera_answer* response) override;
+
+  grpc::ServerBidiReactor<server::signal_message, server::signal_message>* signal(
+      grpc::CallbackServerContext* context) override;
 };
\ No newline at end of file
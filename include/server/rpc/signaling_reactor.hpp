@@ -0,0 +1,44 @@
+#pragma once
+
+#include <grpcpp/grpcpp.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "common/rpc/write_queue.hpp"
+#include "grpc/server.grpc.pb.h"
+#include "server/sessions/camera_receiver.hpp"
+
+// Server side of one robot's signaling stream, which lives as long as the robot's peer connection
+// The first description creates the camera receiver, which answers right away; its local candidates are
+// streamed back as libdatachannel gathers them and remote candidates are applied as they arrive
+// Later descriptions renegotiate tracks and bindings map robot sessions onto them
+// Errors are reported in-band, the receiver is closed when the robot ends the stream. Deletes itself in OnDone
+
+class signaling_reactor final : public grpc::ServerBidiReactor<server::signal_message, server::signal_message> {
+ public:
+  // Registers a receiver for the session, nullptr with status set when it cannot be created
+  using receiver_factory =
+      std::function<std::shared_ptr<camera_receiver>(const std::string &sid, grpc::Status &status)>;
+
+ private:
+  receiver_factory make_receiver;
+  server::signal_message incoming;
+
+  // Outlives the reactor, receiver callbacks may still queue into it once the stream is finished
+  std::shared_ptr<write_queue<server::signal_message>> outgoing;
+
+  std::string session_id;
+  std::shared_ptr<camera_receiver> receiver;
+
+  void send(server::signal_message message);
+  void handle_message(const server::signal_message &message);
+
+ public:
+  explicit signaling_reactor(receiver_factory make_receiver);
+
+  void OnReadDone(bool ok) override;
+  void OnWriteDone(bool ok) override;
+  void OnDone() override { delete this; }
+};
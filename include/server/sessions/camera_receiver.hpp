@@ -1,41 +1,129 @@
 #pragma once
 
+#include <grpcpp/alarm.h>
 #include <grpcpp/grpcpp.h>
 
 #include <atomic>
 #include <chrono>
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <rtc/rtc.hpp>
 #include <stdexcept>
-#include <thread>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
 #include "common/chat_utils.hpp"
 #include "common/sessions/base_session.hpp"
+#include "common/utils/timer_wheel.hpp"
 #include "grpc/robot.grpc.pb.h"
 #include "grpc/server.grpc.pb.h"
+#include "server/media/frame_queue.hpp"
+#include "server/media/h264_depacketizer.hpp"
+#include "server/media/rtcp_feedback_sender.hpp"
+#include "server/recognition/recognition_scheduler.hpp"
 
 // Receiving RTP packets from a peer connection and forwarding to Facial Recognition engine
 
 using namespace std::chrono_literals;
 
 class camera_receiver final : public base_session {
+ public:
+  // Invoked exactly once, from a libdatachannel or gRPC alarm thread, empty SDP on failure
+  using answer_callback = std::function<void(const std::string& answer_sdp)>;
+
+  // Trickle ICE, invoked from libdatachannel threads as the answer and local candidates appear
+  struct trickle_callbacks {
+    std::function<void(const std::string& type, const std::string& sdp)> on_description;
+    std::function<void(const std::string& candidate, const std::string& mid)> on_candidate;
+    std::function<void()> on_gathering_done;
+    std::function<void(const std::string& bound_session_id, const recognition_output& result)> on_recognition;
+  };
+
  private:
+  constexpr static auto GATHERING_TIMEOUT = 3s;
+  constexpr static auto IDLE_TIMEOUT = 1s;  // no RTP for this long ends a one-shot session
+  constexpr static uint8_t PAYLOAD_TYPE = 96;
+  constexpr static size_t FRAME_QUEUE_SIZE = 16;       // ~250 ms of 60 fps video waiting for recognition
+  constexpr static size_t MAX_FRAME_SIZE = 512 * 1024;  // largest access unit, a 720p IDR is ~100-200 KB
+  constexpr static uint32_t RECEIVER_SSRC = 1;          // sender SSRC of our RTCP feedback, we send no media
+  constexpr static auto JITTER_PROFILE = jitter_profile::balanced();  // recognition prefers whole frames
+
+  // Per track receive pipeline, RTP in, access units out
+  struct track_pipeline {
+    std::shared_ptr<rtc::Track> track;
+    std::shared_ptr<frame_queue> frames;
+    std::shared_ptr<h264_depacketizer> depacketizer;
+    uint64_t recognition_source{0};  // registered with the scheduler while a session is bound, 0 otherwise
+  };
+
+  // Shared between the gathering callback and the timeout alarm, whichever fires first answers
+  struct pending_answer {
+    std::atomic<bool> done{false};
+    answer_callback on_answer;
+
+    void complete(const std::string& answer_sdp) {
+      if (!done.exchange(true)) on_answer(answer_sdp);
+    }
+  };
+
   std::shared_ptr<robot::robot_service::Stub> stub;
+  std::shared_ptr<recognition_scheduler> scheduler;  // nullptr runs no recognition
+  ingest_config ingest;  // applied to every track of this receiver
   rtc::Configuration config{};  // customize (STUN/TURN) as needed
   std::shared_ptr<rtc::PeerConnection> pc;
-  std::shared_ptr<rtc::RtcpReceivingSession> rtcp_session;
-  std::vector<std::shared_ptr<rtc::Track>> tracks;
 
-  std::thread watchdog_thread;
-  std::atomic<bool> watchdog_running;
-  std::atomic<std::chrono::steady_clock::time_point> last_packet_time;
+  std::mutex tracks_mtx;  // tracks arrive on libdatachannel threads when the robot renegotiates
+  std::unordered_map<std::string, track_pipeline> tracks;  // by mid, keeps tracks alive
+  std::unordered_map<std::string, std::string> bindings;  // mid -> session currently streaming on it
+  std::function<void(const std::string&, const recognition_output&)> on_recognition;
+
+  // Inactivity watchdog on the shared timer wheel, a packet re-arms it by storing its arrival time
+  // and the timer catches up lazily, so the packet path never touches the wheel
+  std::shared_ptr<timer_wheel> timers;
+  std::atomic<timer_wheel::timer_id> watchdog_timer;
+  std::atomic<int64_t> last_packet_ns;  // steady clock
+  bool one_shot;  // created through create_receiver(), ends when its media stops
+
+  grpc::Alarm gathering_alarm;  // cancelled (and its callback run with ok = false) on destruction
+
+  void setup_peer_connection();
+  void attach_track(std::shared_ptr<rtc::Track> track);
+  static h264_depacketizer::feedback make_feedback(std::weak_ptr<rtc::Track> track,
+                                                   std::weak_ptr<rtcp_feedback_sender> sender);
+  void arm_watchdog();
+  void check_idle();
+
+  // tracks_mtx held, a track is recognized once it is both attached and bound, whichever happens last
+  void start_recognition(const std::string& mid);
+  void stop_recognition(track_pipeline& pipeline);
 
  public:
   camera_receiver() = delete;
-  camera_receiver(const std::string& sid, std::shared_ptr<robot::robot_service::Stub> stub);
+  camera_receiver(const std::string& sid, std::shared_ptr<robot::robot_service::Stub> stub,
+                  std::shared_ptr<recognition_scheduler> scheduler = nullptr,
+                  ingest_config ingest = ingest_config::all());
   ~camera_receiver() override;
 
-  std::string create_receiver(const std::string& offer_sdp);
+  // Returns immediately, on_answer gets the answer SDP once ICE gathering completes or times out
+  void create_receiver(const std::string& offer_sdp, answer_callback on_answer);
+
+  // Answers without waiting for gathering, candidates follow through the callbacks, false on a bad offer
+  // One receiver serves a robot's persistent connection, every offered track is accepted
+  bool accept_offer(const std::string& offer_sdp, trickle_callbacks callbacks);
+  bool add_remote_candidate(const std::string& candidate, const std::string& mid);
+
+  // Renegotiation on an accepted connection, the answer goes out through on_description
+  bool apply_offer(const std::string& offer_sdp);
+
+  // Robot sessions are bound to pooled tracks by mid, no new connection per session
+  // A bound track feeds the recognition scheduler until the session gets its outcome or is unbound
+  void bind_track(const std::string& mid, const std::string& bound_session_id, bool bound);
+
+  // Closes the connection and marks the receiver for cleanup
+  void close();
+
+  // Access units of a track, consumed by a single reader (the scheduler while bound); nullptr for an unknown mid
+  std::shared_ptr<frame_queue> get_frames(const std::string& mid);
 };
\ No newline at end of file
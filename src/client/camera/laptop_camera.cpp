@@ -1,6 +1,9 @@
 #include "client/camera/laptop_camera.hpp"
 
+#include <algorithm>
+#include <array>
 #include <chrono>
+#include <cstring>
 #include <random>
 
 using namespace std::chrono_literals;
@@ -36,12 +39,82 @@ auto laptop_camera::process_objects() -> void {
   }
 }
 
+auto laptop_camera::stream_video() -> void {
+  constexpr static uint8_t SPS[] = {0x67, 0x42, 0xC0, 0x1F, 0xDA, 0x01, 0x40, 0x16, 0xE8};
+  constexpr static uint8_t PPS[] = {0x68, 0xCE, 0x3C, 0x80};
+
+  auto frame = uint32_t{0};
+  auto next = std::chrono::steady_clock::now();
+
+  while (is_running.load()) {
+    next += std::chrono::microseconds(1000000 / FPS);
+
+    if (video_capture.load() && packet_ring) {
+      if (frame % GOP_SIZE == 0) {
+        publish_rtp(SPS, sizeof(SPS), false);
+        publish_rtp(PPS, sizeof(PPS), false);
+        publish_frame(0x65, IDR_SIZE);  // IDR slice, nal_ref_idc 3
+      } else {
+        publish_frame(0x41, SLICE_SIZE);  // non-IDR slice, nal_ref_idc 2
+      }
+
+      rtp_timestamp += CLOCK_RATE / FPS;
+      ++frame;
+    }
+
+    std::this_thread::sleep_until(next);
+  }
+}
+
+auto laptop_camera::publish_frame(uint8_t nal_header, size_t size) -> void {
+  auto payload = std::array<uint8_t, MAX_PAYLOAD>{};
+
+  if (size + 1 <= MAX_PAYLOAD) {
+    payload[0] = nal_header;
+    std::memset(payload.data() + 1, 0xAB, size);
+    publish_rtp(payload.data(), size + 1, true);
+    return;
+  }
+
+  // FU-A fragmentation, indicator keeps the NRI of the original header
+  constexpr auto CHUNK = MAX_PAYLOAD - 2;
+  for (auto offset = size_t{0}; offset < size; offset += CHUNK) {
+    auto len = std::min(CHUNK, size - offset);
+    auto is_start = offset == 0;
+    auto is_end = offset + len == size;
+
+    payload[0] = static_cast<uint8_t>((nal_header & 0xE0) | 28);
+    payload[1] = static_cast<uint8_t>((is_start ? 0x80 : 0) | (is_end ? 0x40 : 0) | (nal_header & 0x1F));
+    std::memset(payload.data() + 2, 0xAB, len);
+    publish_rtp(payload.data(), len + 2, is_end);
+  }
+}
+
+auto laptop_camera::publish_rtp(const uint8_t* payload, size_t len, bool marker) -> void {
+  auto packet = std::array<uint8_t, 12 + MAX_PAYLOAD>{};
+
+  packet[0] = 0x80;  // version 2, no padding, extension or CSRC
+  packet[1] = static_cast<uint8_t>((marker ? 0x80 : 0) | PAYLOAD_TYPE);
+  packet[2] = static_cast<uint8_t>(rtp_seq >> 8);
+  packet[3] = static_cast<uint8_t>(rtp_seq);
+  for (auto i = 0; i < 4; ++i) {
+    packet[4 + i] = static_cast<uint8_t>(rtp_timestamp >> (24 - 8 * i));
+    packet[8 + i] = static_cast<uint8_t>(SSRC >> (24 - 8 * i));
+  }
+  std::memcpy(packet.data() + 12, payload, len);
+  ++rtp_seq;
+
+  auto now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch());
+  publish_packet(packet.data(), 12 + len, now.count());
+}
+
 auto laptop_camera::start() -> bool {
   is_running.store(true);
   video_capture.store(true);
   object_detection.store(true);
 
   detection_thread = std::thread([this]() { this->detect_objects(); });
+  stream_thread = std::thread([this]() { this->stream_video(); });
   return true;
 }
 
@@ -51,4 +124,5 @@ auto laptop_camera::stop() -> void {
   is_running.store(false);
 
   if (detection_thread.joinable()) detection_thread.join();
+  if (stream_thread.joinable()) stream_thread.join();
 }
\ No newline at end of file
@@ -0,0 +1,204 @@
+#include "client/ipc/shm_packet_ring.hpp"
+
+#include <fcntl.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+namespace {
+constexpr size_t CACHE_LINE = 64;
+
+size_t round_up(size_t value, size_t align) { return (value + align - 1) / align * align; }
+
+uint32_t next_pow2(uint32_t value) {
+  auto out = uint32_t{1};
+  while (out < value) out <<= 1;
+  return out;
+}
+}  // namespace
+
+shm_packet_ring::shm_packet_ring(std::string name, bool owner)
+    : name{std::move(name)},
+      owner{owner},
+      shm_fd{-1},
+      event_fd{-1},
+      mapping{MAP_FAILED},
+      mapping_size{0},
+      stride{0} {}
+
+shm_packet_ring::~shm_packet_ring() {
+  if (mapping != MAP_FAILED) munmap(mapping, mapping_size);
+  if (shm_fd >= 0) ::close(shm_fd);
+  if (event_fd >= 0) ::close(event_fd);
+  if (owner) shm_unlink(name.c_str());
+}
+
+shm_packet_ring::slot* shm_packet_ring::slot_at(uint64_t n) const {
+  auto base = static_cast<char*>(mapping) + round_up(sizeof(header), CACHE_LINE);
+  return reinterpret_cast<slot*>(base + (n & (hdr()->slot_count - 1)) * stride);
+}
+
+auto shm_packet_ring::create(const std::string& name, uint32_t slot_count, uint32_t slot_size)
+    -> std::shared_ptr<shm_packet_ring> {
+  auto ring = std::shared_ptr<shm_packet_ring>(new shm_packet_ring(name, true));
+  slot_count = next_pow2(slot_count == 0 ? 1 : slot_count);
+
+  shm_unlink(name.c_str());  // stale mapping from a previous run
+  ring->shm_fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (ring->shm_fd < 0) throw std::runtime_error("Failed to create shared memory ring " + name);
+
+  ring->stride = round_up(sizeof(slot) + slot_size, CACHE_LINE);
+  ring->mapping_size = round_up(sizeof(header), CACHE_LINE) + ring->stride * slot_count;
+
+  if (ftruncate(ring->shm_fd, static_cast<off_t>(ring->mapping_size)) < 0) {
+    throw std::runtime_error("Failed to size shared memory ring " + name);
+  }
+
+  ring->mapping = mmap(nullptr, ring->mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, ring->shm_fd, 0);
+  if (ring->mapping == MAP_FAILED) throw std::runtime_error("Failed to map shared memory ring " + name);
+
+  auto h = new (ring->mapping) header{};
+  h->magic = MAGIC;
+  h->version = VERSION;
+  h->slot_count = slot_count;
+  h->slot_size = slot_size;
+  h->write_seq.store(0, std::memory_order_relaxed);
+  h->armed.store(0, std::memory_order_relaxed);
+
+  for (auto n = uint64_t{0}; n < slot_count; ++n) {
+    auto s = new (ring->slot_at(n)) slot{};
+    s->seq.store(0, std::memory_order_relaxed);
+  }
+
+  ring->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (ring->event_fd < 0) throw std::runtime_error("Failed to create eventfd for ring " + name);
+
+  std::atomic_thread_fence(std::memory_order_release);
+  return ring;
+}
+
+auto shm_packet_ring::open(const std::string& name) -> std::shared_ptr<shm_packet_ring> {
+  auto ring = std::shared_ptr<shm_packet_ring>(new shm_packet_ring(name, false));
+
+  ring->shm_fd = shm_open(name.c_str(), O_RDWR, 0600);
+  if (ring->shm_fd < 0) throw std::runtime_error("Failed to open shared memory ring " + name);
+
+  struct stat st = {};
+  if (fstat(ring->shm_fd, &st) < 0 || static_cast<size_t>(st.st_size) < sizeof(header)) {
+    throw std::runtime_error("Shared memory ring " + name + " is not initialized");
+  }
+
+  ring->mapping_size = static_cast<size_t>(st.st_size);
+  ring->mapping = mmap(nullptr, ring->mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, ring->shm_fd, 0);
+  if (ring->mapping == MAP_FAILED) throw std::runtime_error("Failed to map shared memory ring " + name);
+
+  auto h = ring->hdr();
+  if (h->magic != MAGIC || h->version != VERSION) {
+    throw std::runtime_error("Shared memory ring " + name + " has an incompatible layout");
+  }
+
+  ring->stride = round_up(sizeof(slot) + h->slot_size, CACHE_LINE);
+  if (round_up(sizeof(header), CACHE_LINE) + ring->stride * h->slot_count > ring->mapping_size) {
+    throw std::runtime_error("Shared memory ring " + name + " is truncated");
+  }
+
+  ring->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (ring->event_fd < 0) throw std::runtime_error("Failed to create eventfd for ring " + name);
+
+  return ring;
+}
+
+bool shm_packet_ring::publish(const void* data, size_t len, int64_t timestamp_ns) {
+  auto h = hdr();
+  if (len > h->slot_size) return false;
+
+  auto n = h->write_seq.load(std::memory_order_relaxed);  // single producer
+  auto s = slot_at(n);
+
+  s->seq.store(2 * n + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  std::memcpy(reinterpret_cast<char*>(s) + sizeof(slot), data, len);
+  s->len = static_cast<uint32_t>(len);
+  s->timestamp_ns = timestamp_ns;
+
+  s->seq.store(2 * n + 2, std::memory_order_release);
+  h->write_seq.store(n + 1);  // seq_cst, pairs with arm()
+
+  // Only pay for a syscall when a consumer went to sleep on the eventfd
+  if (h->armed.load() && h->armed.exchange(0)) {
+    uint64_t one = 1;
+    [[maybe_unused]] auto ret = ::write(event_fd, &one, sizeof(one));
+  }
+
+  return true;
+}
+
+size_t shm_packet_ring::read(cursor& cur, void* buffer, size_t capacity, int64_t* timestamp_ns) const {
+  auto h = hdr();
+  auto write = h->write_seq.load(std::memory_order_acquire);
+
+  // Lapped by the producer, skip to the oldest packet still in the ring
+  if (write - cur.next > h->slot_count) {
+    cur.lost += write - h->slot_count - cur.next;
+    cur.next = write - h->slot_count;
+  }
+
+  while (cur.next < write) {
+    auto s = slot_at(cur.next);
+    auto expected = 2 * cur.next + 2;
+
+    auto before = s->seq.load(std::memory_order_acquire);
+    if (before != expected) {
+      // Being overwritten by a newer lap
+      ++cur.lost;
+      ++cur.next;
+      continue;
+    }
+
+    auto len = static_cast<size_t>(s->len);
+    if (len > capacity) {
+      ++cur.lost;
+      ++cur.next;
+      continue;
+    }
+
+    std::memcpy(buffer, reinterpret_cast<const char*>(s) + sizeof(slot), len);
+    if (timestamp_ns) *timestamp_ns = s->timestamp_ns;
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    ++cur.next;
+
+    if (s->seq.load(std::memory_order_relaxed) != before) {
+      ++cur.lost;  // torn read, the producer lapped us while copying
+      continue;
+    }
+
+    return len;
+  }
+
+  return 0;
+}
+
+auto shm_packet_ring::subscribe() const -> cursor {
+  auto cur = cursor{};
+  cur.next = hdr()->write_seq.load(std::memory_order_acquire);
+  return cur;
+}
+
+bool shm_packet_ring::arm(const cursor& cur) {
+  auto h = hdr();
+  h->armed.store(1);  // seq_cst, pairs with publish()
+  return cur.next >= h->write_seq.load();
+}
+
+void shm_packet_ring::clear_notification() const {
+  uint64_t value;
+  while (::read(event_fd, &value, sizeof(value)) > 0) {
+  }
+}
@@ -7,22 +7,24 @@
 
 robot_rpc_manager::robot_rpc_manager()
     : channel{grpc::CreateChannel("localhost:6001", grpc::InsecureChannelCredentials())},
-      stub{server::server_service::NewStub(channel)} {
-  // Constructor body (if needed)
-  is_running.store(true);
-  periodic_thread = std::thread([this]() {
-    while (is_running.load()) {
-      std::this_thread::sleep_for(std::chrono::seconds(1));
-      cleanup_sessions();
-    }
-  });
+      stub{server::server_service::NewStub(channel)},
+      link{std::make_shared<peer_link>(generate_id(), stub)},
+      timers{timer_wheel::shared()} {
+  reaper_thread = std::thread([this]() { this->reaper_loop(); });
 }
 
 robot_rpc_manager::~robot_rpc_manager() {
-  is_running.store(false);
-  if (periodic_thread.joinable()) {
-    periodic_thread.join();
+  // Outside the table, cancel waits for a reclaim that is running and takes a shard lock
+  auto reclaim_timers = std::vector<timer_wheel::timer_id>{};
+  sessions.for_each([&](const std::string&, session_entry& entry) { reclaim_timers.push_back(entry.reclaim_timer); });
+  for (auto timer : reclaim_timers) timers->cancel(timer);
+
+  {
+    std::lock_guard<std::mutex> lock(reaper_mtx);
+    reaper_stopping = true;
   }
+  reaper_cv.notify_one();
+  if (reaper_thread.joinable()) reaper_thread.join();
 }
 
 grpc::Status robot_rpc_manager::stop_camera_stream(grpc::ServerContext* context, const robot::generic_message* request,
@@ -45,43 +47,73 @@ grpc::Status robot_rpc_manager::offer(grpc::ServerContext* context, const robot:
 std::string robot_rpc_manager::init_camera_stream(
     std::function<void()> on_start = [] {}, std::function<void()> on_server_error = [] {},
     std::function<void()> on_camera_error = [] {}, std::function<void()> on_timeout = [] {},
-    std::function<void()> on_end = [] {}) {
+    std::function<void()> on_end = [] {}, std::function<void(bool greeted)> on_result = [](bool) {}) {
   // Implementation of the method
-  auto sid = generate_id();
-  std::lock_guard<std::mutex> lock(mtx);
-  sessions.try_emplace(sid, std::make_shared<camera_streamer>(sid, 6000, stub));
+  auto slot = sessions.reserve();
+  if (!slot) {
+    LOG_WARNING(logger, "Max sessions reached, cannot start a camera stream");
+    timers->schedule(std::chrono::milliseconds(0), on_server_error);  // not from inside the caller's state entry
+    return {};
+  }
 
-  auto streamer = std::dynamic_pointer_cast<camera_streamer>(sessions[sid]);
+  // Built and started without any table lock held
+  auto sid = generate_id();
+  auto streamer = packet_ring ? std::make_shared<camera_streamer>(sid, packet_ring, link)
+                              : std::make_shared<camera_streamer>(sid, RTP_PORT, link);
   streamer->set_on_start(on_start);
   streamer->set_on_server_error(on_server_error);
   streamer->set_on_camera_error(on_camera_error);
   streamer->set_on_timeout(on_timeout);
   streamer->set_on_end(on_end);
+  streamer->set_on_result(on_result);
+  add_session(std::move(slot), sid, streamer);
   streamer->create_stream();
 
   return sid;
 }
 
 void robot_rpc_manager::stop_camera_stream(const std::string& session_id) {
-  std::lock_guard<std::mutex> lock(mtx);
-  auto it = sessions.find(session_id);
-  if (it != sessions.end()) {
-    std::dynamic_pointer_cast<camera_streamer>(it->second)->remove_stream();
+  if (auto entry = sessions.find(session_id)) {
+    std::dynamic_pointer_cast<camera_streamer>(entry->session)->remove_stream();
+  }
+}
+
+bool robot_rpc_manager::add_session(session_table<session_entry>::reservation&& slot, const std::string& session_id,
+                                 std::shared_ptr<base_session> session) {
+  auto timer = timers->schedule(RECLAIM_INTERVAL, [this, session_id]() { reclaim_session(session_id); });
+  session->set_on_inactive([timers = timers, timer]() { timers->rearm(timer, std::chrono::milliseconds(0)); });
+  if (sessions.insert(std::move(slot), session_id, session_entry{std::move(session), timer})) return true;
+
+  timers->cancel(timer);
+  return false;
+}
+
+void robot_rpc_manager::reclaim_session(const std::string& session_id) {
+  // The erased session is released after the shard lock, tearing a session down can take a while
+  auto reclaimed = sessions.erase_if(session_id, [this](session_entry& entry) {
+    if (!entry.session->is_active()) return true;
+    timers->rearm(entry.reclaim_timer, RECLAIM_INTERVAL);
+    return false;
+  });
+  if (!reclaimed) return;
+
+  LOG_INFO(logger, "Cleaning up inactive session: {}", session_id);
+  {
+    std::lock_guard<std::mutex> lock(reaper_mtx);
+    reaped.push_back(std::move(reclaimed->session));
   }
+  reaper_cv.notify_one();
 }
 
-void robot_rpc_manager::cleanup_sessions() {
-  std::lock_guard<std::mutex> lock(mtx);
-
-  // Use an explicit iterator
-  for (auto it = sessions.begin(); it != sessions.end();) {
-    // Check if the session is inactive
-    if (!it->second->is_active()) {
-      LOG_INFO(logger, "Cleaning up inactive session: {}", it->first);
-      it = sessions.erase(it);
-    } else {
-      // If the element is kept, move to the next element.
-      ++it;
+void robot_rpc_manager::reaper_loop() {
+  auto batch = std::vector<std::shared_ptr<base_session>>{};
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(reaper_mtx);
+      reaper_cv.wait(lock, [this]() { return reaper_stopping || !reaped.empty(); });
+      batch.swap(reaped);
+      if (batch.empty() && reaper_stopping) return;
     }
+    batch.clear();  // the last references of the sessions, torn down outside the lock
   }
 }
\ No newline at end of file
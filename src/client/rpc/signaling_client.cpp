@@ -0,0 +1,97 @@
+#include "client/rpc/signaling_client.hpp"
+
+#include "common/chat_utils.hpp"
+
+signaling_client::signaling_client(const std::string& sid, message_callback on_message, done_callback on_done)
+    : session_id{sid}, on_message{std::move(on_message)}, on_done{std::move(on_done)} {}
+
+auto signaling_client::start(server::server_service::Stub& stub, const std::string& sid, message_callback on_message,
+                             done_callback on_done) -> std::shared_ptr<signaling_client> {
+  auto client = std::shared_ptr<signaling_client>(new signaling_client(sid, std::move(on_message), std::move(on_done)));
+  client->self = client;
+
+  stub.async()->signal(&client->context, client.get());
+  client->StartRead(&client->incoming);
+  client->StartCall();
+  return client;
+}
+
+void signaling_client::send(server::signal_message message) {
+  message.set_session_id(session_id);
+  if (auto next = outgoing.push(std::move(message))) StartWrite(next);
+}
+
+void signaling_client::send_description(const std::string& type, const std::string& sdp) {
+  auto message = server::signal_message{};
+  message.mutable_description()->set_type(type);
+  message.mutable_description()->set_sdp(sdp);
+  send(std::move(message));
+}
+
+void signaling_client::send_candidate(const std::string& candidate, const std::string& mid) {
+  auto message = server::signal_message{};
+  message.mutable_candidate()->set_candidate(candidate);
+  message.mutable_candidate()->set_mid(mid);
+  send(std::move(message));
+}
+
+void signaling_client::send_end_of_candidates() {
+  auto message = server::signal_message{};
+  message.set_end_of_candidates(true);
+  send(std::move(message));
+}
+
+void signaling_client::send_binding(const std::string& bound_session_id, const std::string& mid, bool bound) {
+  auto message = server::signal_message{};
+  message.mutable_binding()->set_mid(mid);
+  message.mutable_binding()->set_bound(bound);
+
+  // Bindings carry the session they belong to instead of the link id
+  message.set_session_id(bound_session_id);
+  if (auto next = outgoing.push(std::move(message))) StartWrite(next);
+}
+
+void signaling_client::close() {
+  if (outgoing.close()) StartWritesDone();
+}
+
+void signaling_client::detach() {
+  {
+    std::lock_guard<std::mutex> lock(callback_mtx);
+    on_message = nullptr;
+    on_done = nullptr;
+  }
+  context.TryCancel();
+}
+
+void signaling_client::OnReadDone(bool ok) {
+  if (!ok) return;  // server ended the stream, OnDone follows
+
+  {
+    std::lock_guard<std::mutex> lock(callback_mtx);
+    if (on_message) on_message(incoming);
+  }
+
+  StartRead(&incoming);
+}
+
+void signaling_client::OnWriteDone(bool ok) {
+  if (!ok) LOG_WARNING(logger, "Signaling write failed for session {}", session_id);
+
+  auto finish = false;
+  if (auto next = outgoing.pop(ok, finish)) {
+    StartWrite(next);
+  } else if (finish && ok) {
+    StartWritesDone();
+  }
+}
+
+void signaling_client::OnDone(const grpc::Status& status) {
+  {
+    std::lock_guard<std::mutex> lock(callback_mtx);
+    if (on_done) on_done(status);
+  }
+
+  // May destroy this object
+  auto keep = std::move(self);
+}
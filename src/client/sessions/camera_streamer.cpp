@@ -5,15 +5,17 @@
 #include <sys/socket.h>
 #include <unistd.h>
 
-#include <future>
+#include <cerrno>
+#include <cstring>
 
 #include "common/chat_utils.hpp"
 
-std::unordered_map<int, camera_streamer::capture> camera_streamer::captures;
+std::unordered_map<std::string, std::shared_ptr<camera_streamer::capture>> camera_streamer::captures;
+std::mutex camera_streamer::captures_mtx;
 
 // Helper functions
 int make_socket(int port, size_t buffer_size) {
-  int sock = socket(AF_INET, SOCK_DGRAM, 0);
+  int sock = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);  // driven by the capture reactor
 
   struct sockaddr_in addr = {};
   addr.sin_family = AF_INET;
@@ -25,87 +27,290 @@ int make_socket(int port, size_t buffer_size) {
     throw std::runtime_error("Failed to bind UDP socket on 127.0.0.1:" + std::to_string(port));
   }
 
-  struct timeval timeout;
-  timeout.tv_sec = 1;  // 1 second timeout for recv()
-  timeout.tv_usec = 0;
-  setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
   setsockopt(sock, SOL_SOCKET, SO_RCVBUF, reinterpret_cast<const char*>(&buffer_size), sizeof(buffer_size));
 
+  int enable = 1;  // kernel receive timestamps, delivered as SCM_TIMESTAMPNS with every datagram
+  setsockopt(sock, SOL_SOCKET, SO_TIMESTAMPNS, &enable, sizeof(enable));
+
   return sock;
 }
 
 // Class methods
 
-void camera_streamer::capture_work(int port) {
-  std::array<char, 2048> buffer;
-  auto sock = captures[port].socket;
-  captures[port].has_data.store(false);
-  int len{};
-
-  LOG_DEBUG(logger, "Waiting for RTP packets on port {}", port);
-
-  while (captures[port].is_running.load()) {
-    // Try to read
-    len = recv(sock, buffer.data(), buffer.size(), 0);  // returns -1 when no data
-
-    if (len < 0 || len < sizeof(rtc::RtpHeader)) {
-      captures[port].has_data.store(false);
-      captures[port].capture_cv.notify_all();
-      LOG_DEBUG(logger, "Invalid RTP packet received on port {}, Number of links {}", port,
-                captures[port].uplinks.size());
-      for (const auto& link : captures[port].uplinks) link.on_camera_error();
-      std::this_thread::sleep_for(10ms);  // Wait before retrying
-      continue;                           // Ignore invalid packets
+void camera_streamer::capture_work(capture& cap) {
+  auto& pool = *cap.pool;
+  auto& ring = *cap.ring;
+
+  // Edge triggered, keep reading until the socket is drained
+  while (true) {
+    // Arm as many slots as the pool allows, the kernel fills them in a single syscall
+    auto armed = size_t{0};
+    for (; armed < RECV_BATCH; ++armed) {
+      if (!ring.slots[armed] && !(ring.slots[armed] = pool.acquire())) break;
+
+      ring.iovs[armed].iov_base = ring.slots[armed].get()->data.data();
+      ring.iovs[armed].iov_len = rtp_packet::MAX_SIZE;
+      ring.msgs[armed].msg_hdr = msghdr{};
+      ring.msgs[armed].msg_hdr.msg_iov = &ring.iovs[armed];
+      ring.msgs[armed].msg_hdr.msg_iovlen = 1;
+      ring.msgs[armed].msg_hdr.msg_control = ring.controls[armed].data();
+      ring.msgs[armed].msg_hdr.msg_controllen = ring.controls[armed].size();
     }
 
-    LOG_DEBUG(logger, "Received RTP packet of size {} on port {}", len, port);
+    if (armed == 0) {
+      // Every buffer is still queued on some uplink, drain one datagram so the socket does not back up
+      char discard[rtp_packet::MAX_SIZE];
+      if (recv(cap.fd, discard, sizeof(discard), 0) < 0) break;
+      LOG_WARNING(logger, "Packet pool exhausted on capture {}, dropping packet", cap.name);
+      continue;
+    }
+
+    auto received = recvmmsg(cap.fd, ring.msgs.data(), static_cast<unsigned int>(armed), 0, nullptr);
+
+    if (received < 0 && errno == EINTR) continue;
+    if (received <= 0) break;  // EAGAIN, drained until the next edge
+
+    // Collect the valid packets of the batch, invalid slots stay armed for the next syscall
+    auto count = size_t{0};
+    for (auto i = 0; i < received; ++i) {
+      if (ring.msgs[i].msg_len < sizeof(rtc::RtpHeader)) continue;  // Ignore invalid packets
+
+      auto packet = ring.slots[i].get();
+      packet->len = ring.msgs[i].msg_len;
+      packet->rx_time_ns = 0;
+      for (auto cmsg = CMSG_FIRSTHDR(&ring.msgs[i].msg_hdr); cmsg; cmsg = CMSG_NXTHDR(&ring.msgs[i].msg_hdr, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+          auto ts = timespec{};
+          std::memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+          packet->rx_time_ns = static_cast<int64_t>(ts.tv_sec) * 1'000'000'000 + ts.tv_nsec;
+        }
+      }
+
+      ring.batch[count++] = std::move(ring.slots[i]);
+    }
+
+    if (count == 0) continue;
+
+    deliver_batch(cap, count);
+  }
+
+  // Report a camera error if the port goes quiet, a silent port is not polled
+  capture_reactor::get_instance().arm_stall(cap.fd, STALL_TIMEOUT);
+}
+
+void camera_streamer::shm_capture_work(capture& cap) {
+  auto& pool = *cap.pool;
+  auto& ring = *cap.ring;
+  auto& shm = *cap.shm;
+
+  shm.clear_notification();
+  auto lost = cap.cursor.lost;
+
+  while (true) {
+    // Copy out of the ring into pooled packets, the slot may be overwritten once the producer laps us
+    auto count = size_t{0};
+    auto drained = false;
+    while (count < RECV_BATCH) {
+      auto packet = pool.acquire();
+      if (!packet) {
+        // Every buffer is still queued on some uplink, discard a packet so the ring keeps moving like the UDP path
+        // does; re-arming with data left would wake the reactor right away and spin
+        if (count == 0) {
+          char discard[rtp_packet::MAX_SIZE];
+          drained = shm.read(cap.cursor, discard, sizeof(discard)) == 0;
+          if (!drained) LOG_WARNING(logger, "Packet pool exhausted on capture {}, dropping packet", cap.name);
+        }
+        break;
+      }
+
+      auto len = shm.read(cap.cursor, packet.get()->data.data(), rtp_packet::MAX_SIZE, &packet.get()->rx_time_ns);
+      if (len == 0) {
+        drained = true;
+        break;
+      }
+      if (len < sizeof(rtc::RtpHeader)) continue;  // Ignore invalid packets, the buffer goes back to the pool
+
+      packet.get()->len = len;
+      ring.batch[count++] = std::move(packet);
+    }
+
+    if (count > 0) deliver_batch(cap, count);
+    if (!drained) continue;
+
+    // Drained, ask the producer for a wakeup, unless something slipped in meanwhile
+    if (shm.arm(cap.cursor)) break;
+  }
+
+  if (cap.cursor.lost != lost) {
+    LOG_WARNING(logger, "Capture {} fell behind the shared memory ring, {} packets lost so far", cap.name,
+                cap.cursor.lost);
+  }
+
+  capture_reactor::get_instance().arm_stall(cap.fd, STALL_TIMEOUT);
+}
 
-    // Process RTP packet if needed
-    // Dispatch to all uplinks with synchronization barrier
-    std::vector<std::future<void>> futures;
-    futures.reserve(captures[port].uplinks.size());
-    captures[port].has_data.store(true);
-    captures[port].capture_cv.notify_all();
+void camera_streamer::deliver_batch(capture& cap, size_t count) {
+  auto& ring = *cap.ring;
 
-    // Asynchronously send to all uplinks
-    for (const auto& link : captures[port].uplinks) {
-      futures.emplace_back(std::async(std::launch::async, [&link, &buffer, len]() { link.on_data(buffer, len); }));
+  // Hand the whole batch to every uplink's sender worker, a full queue drops instead of blocking capture
+  // Late joiners first get the cached keyframe so their decoder does not wait for the next IDR
+  auto uplinks = cap.uplinks.read();
+  for (const auto& link : *uplinks) {
+    // The first packets of a new uplink start its session, unless its start timeout already reported it
+    if (link->start.load(std::memory_order_relaxed) != start_state::STARTED) {
+      auto expected = start_state::PENDING;
+      if (!link->start.compare_exchange_strong(expected, start_state::STARTED)) continue;
+      link->on_start();
     }
 
-    // Wait for all threads to complete before updating the buffer again
-    for (auto& future : futures) {
-      future.wait();
+    if (link->needs_replay) {
+      link->needs_replay = false;
+      if (cap.keyframes->replay(*link->worker)) {
+        LOG_DEBUG(logger, "Replayed cached keyframe to session {}", link->session_id);
+      }
+    }
+
+    if (link->worker->push(ring.batch.data(), count) < count) {
+      LOG_DEBUG(logger, "Uplink queue full for session {}, {} packets dropped so far", link->session_id,
+                link->worker->get_dropped());
     }
   }
 
-  captures[port].has_data.store(false);
-  captures[port].capture_cv.notify_all();
+  // Update the cache only after the batch went out, so a replay never duplicates live packets
+  for (auto i = size_t{0}; i < count; ++i) {
+    cap.keyframes->observe(ring.batch[i]);
+    ring.batch[i] = packet_ref{};
+  }
+}
 
-  LOG_DEBUG(logger, "Stopping RTP capture on port {}", port);
+void camera_streamer::capture_stall(capture& cap) {
+  // Nothing for a whole stall timeout, the camera stopped producing
+  auto uplinks = cap.uplinks.read();
+  LOG_DEBUG(logger, "No RTP packets received on capture {}, Number of links {}", cap.name, uplinks->size());
+  for (const auto& link : *uplinks) link->on_camera_error();
 }
 
-void camera_streamer::dispatch_uplink(const uplink& link) {
-  if (captures.find(rtp_port) == captures.end()) {
-    // First uplink for this port, start capture
-    captures.try_emplace(rtp_port);
-    captures[rtp_port].is_running.store(true);
-    captures[rtp_port].socket = make_socket(rtp_port, BUFFER_SIZE);
-    captures[rtp_port].capture_thread =
-        std::thread([this]() { this->capture_work(rtp_port); });  // Start capture thread for the port
+void camera_streamer::send_packet(rtc::Track& track, uint32_t ssrc, const packet_ref& packet,
+                                  rtp_rewriter::mapping numbers) {
+  // The track copies into its own message anyway, so build that message directly and patch the SSRC and the
+  // track's own numbers there instead of touching the packet shared with the other uplinks
+  auto message = rtc::binary(packet.size());
+  std::memcpy(message.data(), packet.data(), packet.size());
+  auto header = reinterpret_cast<rtc::RtpHeader*>(message.data());
+  header->setSsrc(ssrc);
+  header->setSeqNumber(numbers.seq);
+  header->setTimestamp(numbers.timestamp);
+  track.send(std::move(message));
+}
+
+void camera_streamer::answer_nacks(const rtc::binary& message, uplink& up) {
+  // Runs on a libdatachannel thread, resends right away instead of queueing behind live packets
+  auto now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+                 .count();
+  auto resent = size_t{0};
+  auto requested = size_t{0};
+
+  rtcp_nack::for_each_lost(reinterpret_cast<const uint8_t*>(message.data()), message.size(),
+                           [&](uint32_t media_ssrc, uint16_t seq) {
+                             if (media_ssrc != up.ssrc) return;
+                             ++requested;
+                             auto timestamp = uint32_t{0};
+                             if (auto packet = up.history->find(seq, now, timestamp)) {
+                               send_packet(*up.track, up.ssrc, packet, rtp_rewriter::mapping{seq, timestamp});
+                               ++resent;
+                             }
+                           });
+
+  if (requested > resent) {
+    LOG_DEBUG(logger, "Session {} resent {} of {} NACKed packets, {} no longer in history so far", up.session_id,
+              resent, requested, up.history->get_missed());
   }
+}
+
+void camera_streamer::release_capture(const std::string& source) {
+  std::lock_guard<std::mutex> lock(captures_mtx);
+  auto it = captures.find(source);
 
-  // Use a separate scope for the lock to avoid deadlock
+  // Release resources if no more uplinks, nor any still being dispatched to this capture
+  if (it == captures.end() || it->second->dispatching > 0 || !it->second->uplinks.copy().empty()) return;
+
+  capture_reactor::get_instance().remove(it->second->fd);
+  if (!it->second->shm) ::close(it->second->fd);  // the ring owns its eventfd
+  captures.erase(it);
+  LOG_DEBUG(logger, "Camera stream {} destroyed", source);
+}
+
+bool camera_streamer::dispatch_uplink(std::shared_ptr<uplink> link) {
+  auto cap = std::shared_ptr<capture>{};
+  {
+    std::lock_guard<std::mutex> lock(captures_mtx);
+    auto [it, inserted] = captures.try_emplace(source);
+    if (inserted) it->second = std::make_shared<capture>();
+    cap = it->second;
+    ++cap->dispatching;
+
+    if (inserted) {
+      // First uplink for this source, start capture on the shared reactor
+      try {
+        cap->name = source;
+        cap->pool = std::make_unique<packet_pool>(PACKET_POOL_SIZE);
+        cap->ring = std::make_unique<receive_ring>();
+        cap->keyframes = std::make_unique<keyframe_cache>(PAYLOAD_TYPE);
+
+        // Raw pointer is fine, release_capture removes the source before the capture can go away
+        auto raw = cap.get();
+        if (packet_ring) {
+          cap->shm = packet_ring;
+          cap->cursor = packet_ring->subscribe();
+          cap->fd = packet_ring->get_event_fd();
+          packet_ring->arm(cap->cursor);
+          capture_reactor::get_instance().add(
+              cap->fd, [raw]() { shm_capture_work(*raw); }, [raw]() { capture_stall(*raw); });
+        } else {
+          cap->fd = make_socket(rtp_port, BUFFER_SIZE);
+          capture_reactor::get_instance().add(
+              cap->fd, [raw]() { capture_work(*raw); }, [raw]() { capture_stall(*raw); });
+        }
+      } catch (const std::exception& e) {
+        LOG_ERROR(logger, "Failed to start capture {}: {}", source, e.what());
+        if (cap->fd >= 0 && !cap->shm) ::close(cap->fd);
+        captures.erase(it);
+        link->on_camera_error();
+        return false;
+      }
+    }
+  }
+
+  // Attached right away, the reactor starts the session with the first batch it hands this uplink; published before
+  // the dispatch ends so a racing release_capture() that sees no dispatch left also sees this uplink
+  link->worker = std::make_unique<uplink_worker>(UPLINK_QUEUE_SIZE, UPLINK_DROP_POLICY, link->on_data);
+  cap->uplinks.update([&link](std::vector<std::shared_ptr<uplink>>& uplinks) { uplinks.push_back(link); });
   {
-    std::unique_lock<std::mutex> lock(captures[rtp_port].capture_mtx);
-    captures[rtp_port].capture_cv.wait_for(lock, std::chrono::seconds(5),
-                                           [this]() { return captures[rtp_port].has_data.load(); });
+    std::lock_guard<std::mutex> lock(captures_mtx);
+    --cap->dispatching;
   }
 
-  // Add uplink to existing capture
-  if (captures[rtp_port].has_data.load()) {
-    captures[rtp_port].uplinks.push_back(link);
-    link.on_start();  // Notify uplink that streaming has started
-  } else {
-    link.on_timeout();  // Notify uplink of timeout
+  // remove_stream() deactivates before detaching, one of the two sees the other
+  if (!is_active()) {
+    detach_uplink(*cap);
+    return false;
   }
+
+  // A capture that stays quiet reports a timeout instead, its session releases the capture when it ends
+  timer_wheel::shared()->schedule(START_TIMEOUT, [weak = std::weak_ptr<uplink>(link)]() {
+    auto up = weak.lock();
+    auto expected = start_state::PENDING;
+    if (up && up->start.compare_exchange_strong(expected, start_state::TIMED_OUT)) up->on_timeout();
+  });
+  return true;
+}
+
+void camera_streamer::detach_uplink(capture& cap) {
+  // Publishes a new uplink snapshot, the removed uplink's worker stops once the reactor is done with it
+  // Linear search but should be ok since few uplinks are expected
+  cap.uplinks.update([this](std::vector<std::shared_ptr<uplink>>& uplinks) {
+    uplinks.erase(std::remove_if(uplinks.begin(), uplinks.end(),
+                                 [this](const std::shared_ptr<uplink>& u) { return u->session_id == session_id; }),
+                  uplinks.end());
+  });
 }
@@ -0,0 +1,191 @@
+#include "client/sessions/capture_reactor.hpp"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <stdexcept>
+#include <vector>
+
+#include "common/chat_utils.hpp"
+
+using namespace std::chrono_literals;
+
+capture_reactor::capture_reactor()
+    : epoll_fd{epoll_create1(EPOLL_CLOEXEC)},
+      wake_fd{eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)},
+      dispatching_fd{-1},
+      is_running{true} {
+  if (epoll_fd < 0 || wake_fd < 0) {
+    throw std::runtime_error("Failed to create capture reactor");
+  }
+
+  auto ev = epoll_event{};
+  ev.events = EPOLLIN;
+  ev.data.fd = wake_fd;
+  epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &ev);
+
+  reactor_thread = std::thread([this]() { this->reactor_work(); });
+}
+
+capture_reactor::~capture_reactor() {
+  is_running.store(false);
+  wake();
+  if (reactor_thread.joinable()) {
+    reactor_thread.join();
+  }
+
+  ::close(wake_fd);
+  ::close(epoll_fd);
+}
+
+void capture_reactor::wake() {
+  uint64_t one = 1;
+  [[maybe_unused]] auto ret = ::write(wake_fd, &one, sizeof(one));
+}
+
+void capture_reactor::add(int fd, on_readable_fn on_readable, on_stall_fn on_stall) {
+  auto src = std::make_shared<source>();
+  src->fd = fd;
+  src->on_readable = std::move(on_readable);
+  src->on_stall = std::move(on_stall);
+  src->stall_deadline = std::chrono::steady_clock::time_point::max();
+
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    sources[fd] = std::move(src);
+  }
+
+  auto ev = epoll_event{};
+  ev.events = EPOLLIN | EPOLLET;
+  ev.data.fd = fd;
+  if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+    std::lock_guard<std::mutex> lock(mtx);
+    sources.erase(fd);
+    throw std::runtime_error("Failed to register fd " + std::to_string(fd) + " with capture reactor");
+  }
+}
+
+void capture_reactor::remove(int fd) {
+  epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+
+  auto lock = std::unique_lock<std::mutex>(mtx);
+  sources.erase(fd);
+
+  // Wait for an in-flight callback to finish, unless it is the one removing itself
+  if (!in_reactor_thread()) {
+    dispatch_cv.wait(lock, [this, fd]() { return dispatching_fd != fd; });
+  }
+}
+
+void capture_reactor::arm_stall(int fd, std::chrono::milliseconds timeout) {
+  auto deadline = std::chrono::steady_clock::now() + timeout;
+  auto earlier = false;
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    auto it = sources.find(fd);
+    if (it == sources.end()) return;
+    earlier = deadline < it->second->stall_deadline;
+    it->second->stall_deadline = deadline;
+  }
+
+  // The reactor recomputes its timeout before every epoll_wait, other threads must kick it
+  if (earlier && !in_reactor_thread()) wake();
+}
+
+void capture_reactor::disarm_stall(int fd) {
+  std::lock_guard<std::mutex> lock(mtx);
+  auto it = sources.find(fd);
+  if (it != sources.end()) it->second->stall_deadline = std::chrono::steady_clock::time_point::max();
+}
+
+int capture_reactor::next_timeout_ms() {
+  std::lock_guard<std::mutex> lock(mtx);
+  auto earliest = std::chrono::steady_clock::time_point::max();
+  for (const auto& [fd, src] : sources) {
+    if (src->stall_deadline < earliest) earliest = src->stall_deadline;
+  }
+
+  if (earliest == std::chrono::steady_clock::time_point::max()) return -1;  // nothing armed, sleep until I/O
+
+  auto remaining = std::chrono::ceil<std::chrono::milliseconds>(earliest - std::chrono::steady_clock::now());
+  return remaining.count() < 0 ? 0 : static_cast<int>(remaining.count());
+}
+
+void capture_reactor::fire_stalls() {
+  auto now = std::chrono::steady_clock::now();
+  auto expired = std::vector<std::shared_ptr<source>>{};
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    for (auto& [fd, src] : sources) {
+      if (src->stall_deadline <= now) {
+        src->stall_deadline = std::chrono::steady_clock::time_point::max();  // one-shot
+        expired.push_back(src);
+      }
+    }
+  }
+
+  for (const auto& src : expired) {
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      if (sources.find(src->fd) == sources.end()) continue;  // removed meanwhile
+      dispatching_fd = src->fd;
+    }
+
+    src->on_stall();
+
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      dispatching_fd = -1;
+    }
+    dispatch_cv.notify_all();
+  }
+}
+
+void capture_reactor::reactor_work() {
+  constexpr auto MAX_EVENTS = 16;
+  epoll_event events[MAX_EVENTS];
+
+  while (is_running.load()) {
+    auto ready = epoll_wait(epoll_fd, events, MAX_EVENTS, next_timeout_ms());
+
+    if (ready < 0) {
+      if (errno == EINTR) continue;
+      LOG_ERROR(logger, "Capture reactor epoll_wait failed: {}", errno);
+      break;
+    }
+
+    for (auto i = 0; i < ready; ++i) {
+      auto fd = events[i].data.fd;
+
+      if (fd == wake_fd) {
+        uint64_t value;
+        while (::read(wake_fd, &value, sizeof(value)) > 0) {
+        }
+        continue;
+      }
+
+      auto src = std::shared_ptr<source>{};
+      {
+        std::lock_guard<std::mutex> lock(mtx);
+        auto it = sources.find(fd);
+        if (it == sources.end()) continue;  // removed after the event was queued
+        src = it->second;
+        dispatching_fd = fd;
+      }
+
+      src->on_readable();
+
+      {
+        std::lock_guard<std::mutex> lock(mtx);
+        dispatching_fd = -1;
+      }
+      dispatch_cv.notify_all();
+    }
+
+    fire_stalls();
+  }
+
+  LOG_DEBUG(logger, "Capture reactor stopped");
+}
@@ -0,0 +1,66 @@
+#include "client/sessions/keyframe_cache.hpp"
+
+#include "common/rtp/h264.hpp"
+#include "common/rtp/rtp_view.hpp"
+
+keyframe_cache::keyframe_cache(uint8_t payload_type)
+    : payload_type{payload_type}, params_timestamp{0}, building_timestamp{0}, is_building{false}, overflows{0} {
+  params.reserve(MAX_PARAM_PACKETS);
+  building.reserve(MAX_IDR_PACKETS);
+  keyframe.reserve(MAX_PARAM_PACKETS + MAX_IDR_PACKETS);
+}
+
+void keyframe_cache::observe(const packet_ref& packet) {
+  auto rtp = rtp_view{};
+  if (!rtp_view::parse(packet.data(), packet.size(), rtp) || rtp.payload_type != payload_type) return;
+
+  auto info = h264::inspect(rtp.payload, rtp.payload_len);
+
+  // Parameter sets usually travel on their own right before the IDR, keep only the latest group
+  if ((info.has_sps || info.has_pps) && !info.has_idr) {
+    if (params.empty() || rtp.timestamp != params_timestamp || params.size() == MAX_PARAM_PACKETS) params.clear();
+    params.push_back(packet);
+    params_timestamp = rtp.timestamp;
+    return;
+  }
+
+  // A new IDR access unit starts, anything half collected is abandoned
+  if (info.has_idr && (!is_building || rtp.timestamp != building_timestamp)) {
+    building.clear();
+    building_timestamp = rtp.timestamp;
+    is_building = true;
+  }
+
+  if (!is_building) return;
+
+  // The access unit ended without a marker bit (lost packet), wait for the next IDR
+  if (rtp.timestamp != building_timestamp) {
+    building.clear();
+    is_building = false;
+    return;
+  }
+
+  if (building.size() == MAX_IDR_PACKETS) {
+    ++overflows;
+    building.clear();
+    is_building = false;
+    return;
+  }
+
+  building.push_back(packet);
+
+  if (rtp.marker) {
+    // Complete, publish parameter sets followed by the IDR packets
+    keyframe.clear();
+    keyframe.insert(keyframe.end(), params.begin(), params.end());
+    keyframe.insert(keyframe.end(), building.begin(), building.end());
+    building.clear();
+    is_building = false;
+  }
+}
+
+bool keyframe_cache::replay(uplink_worker& worker) const {
+  if (keyframe.empty()) return false;
+  worker.push(keyframe.data(), keyframe.size());
+  return true;
+}
@@ -0,0 +1,41 @@
+#include "client/sessions/packet_pool.hpp"
+
+void packet_ref::release() {
+  if (packet && packet->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    packet->pool->release(packet);
+  }
+  packet = nullptr;
+}
+
+packet_pool::packet_pool(size_t capacity) : slots(capacity), exhausted{0} {
+  free_list.reserve(capacity);
+  for (auto& slot : slots) {
+    slot.pool = this;
+    free_list.push_back(&slot);
+  }
+}
+
+packet_ref packet_pool::acquire() {
+  auto packet = static_cast<rtp_packet*>(nullptr);
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (!free_list.empty()) {
+      packet = free_list.back();
+      free_list.pop_back();
+    }
+  }
+
+  if (!packet) {
+    exhausted.fetch_add(1, std::memory_order_relaxed);
+    return packet_ref{};
+  }
+
+  packet->len = 0;
+  packet->rx_time_ns = 0;
+  return packet_ref{packet};
+}
+
+void packet_pool::release(rtp_packet* packet) {
+  std::lock_guard<std::mutex> lock(mtx);
+  free_list.push_back(packet);  // capacity reserved up front, never reallocates
+}
@@ -0,0 +1,284 @@
+#include "client/sessions/peer_link.hpp"
+
+#include <algorithm>
+
+#include "common/chat_utils.hpp"
+
+peer_link::peer_link(const std::string& link_id, std::shared_ptr<server::server_service::Stub> stub)
+    : stub{stub}, link_id{link_id}, state{link_state::CLOSED}, generation{0}, needs_renegotiation{false} {}
+
+peer_link::~peer_link() {
+  auto old_pc = std::shared_ptr<rtc::PeerConnection>{};
+  auto old_signaling = std::shared_ptr<signaling_client>{};
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    ++generation;
+    old_pc = std::move(pc);
+    old_signaling = std::move(signaling);
+  }
+
+  // Outside the lock, detach() waits for a running signaling callback which may need it
+  if (old_signaling) old_signaling->detach();
+  if (old_pc) old_pc->close();
+}
+
+void peer_link::open() {
+  auto gen = ++generation;
+  auto conn = std::make_shared<rtc::PeerConnection>(config);
+
+  // Messages are applied straight to this connection, the signaling callbacks are dropped before it is replaced
+  auto sig = signaling_client::start(
+      *stub, link_id,
+      [weak = weak_from_this(), gen, conn](const server::signal_message& message) {
+        auto self = weak.lock();
+        if (!self) return;
+        try {
+          switch (message.payload_case()) {
+            case server::signal_message::kDescription:
+              conn->setRemoteDescription(rtc::Description(message.description().sdp(), message.description().type()));
+              break;
+            case server::signal_message::kCandidate:
+              conn->addRemoteCandidate(rtc::Candidate(message.candidate().candidate(), message.candidate().mid()));
+              break;
+            case server::signal_message::kError:
+              self->fail(gen, message.error());
+              break;
+            case server::signal_message::kRecognition:
+              self->on_recognition(message.session_id(), message.recognition().greeted());
+              break;
+            default:
+              break;  // end of candidates and binding acknowledgements need no action
+          }
+        } catch (const std::exception& e) {
+          self->fail(gen, e.what());
+        }
+      },
+      [weak = weak_from_this(), gen](const grpc::Status& status) {
+        if (auto self = weak.lock()) {
+          self->fail(gen, "signaling ended: " + std::to_string(static_cast<int>(status.error_code())) + " " +
+                              status.error_message());
+        }
+      });
+
+  // Set up peer connection event handlers, the offer and candidates go out as soon as they exist
+  conn->onLocalDescription([sig](rtc::Description description) {
+    sig->send_description(description.typeString(), std::string{description});
+  });
+
+  conn->onLocalCandidate(
+      [sig](rtc::Candidate candidate) { sig->send_candidate(std::string{candidate}, candidate.mid()); });
+
+  conn->onGatheringStateChange([sig](rtc::PeerConnection::GatheringState state) {
+    if (state == rtc::PeerConnection::GatheringState::Complete) sig->send_end_of_candidates();
+  });
+
+  // Weak, libdatachannel may still run a callback of a connection that is being closed with this link
+  conn->onSignalingStateChange([weak = weak_from_this(), gen](rtc::PeerConnection::SignalingState state) {
+    auto self = weak.lock();
+    if (self && state == rtc::PeerConnection::SignalingState::Stable) self->renegotiate(gen);
+  });
+
+  conn->onStateChange([weak = weak_from_this(), gen](rtc::PeerConnection::State state) {
+    auto self = weak.lock();
+    if (!self) return;
+
+    if (state == rtc::PeerConnection::State::Connected) {
+      {
+        std::lock_guard<std::mutex> lock(self->mtx);
+        if (gen != self->generation) return;
+        self->state = link_state::CONNECTED;
+      }
+      LOG_INFO(logger, "Peer link {} connected", self->link_id);
+      self->renegotiate(gen);
+    } else if (state == rtc::PeerConnection::State::Disconnected || state == rtc::PeerConnection::State::Failed ||
+               state == rtc::PeerConnection::State::Closed) {
+      self->fail(gen, "peer connection lost");
+    }
+  });
+
+  pc = conn;
+  signaling = sig;
+  slots.clear();
+  needs_renegotiation = false;
+  state = link_state::CONNECTING;
+
+  // The pool is part of the first offer, so borrowing a track never needs a renegotiation
+  for (auto i = size_t{0}; i < TRACK_POOL_SIZE; ++i) add_track();
+
+  LOG_DEBUG(logger, "Peer link {} opening with {} pooled tracks", link_id, TRACK_POOL_SIZE);
+}
+
+auto peer_link::add_track() -> track_slot& {
+  auto index = slots.size();
+  auto slot = std::make_unique<track_slot>();
+  slot->mid = "video-" + std::to_string(index);
+  slot->ssrc = BASE_SSRC + static_cast<uint32_t>(index);
+
+  auto media = rtc::Description::Video(slot->mid, rtc::Description::Direction::SendOnly);
+  media.addH264Codec(PAYLOAD_TYPE);
+  media.addSSRC(slot->ssrc, "video-send-" + std::to_string(index));
+  slot->track = pc->addTrack(media);
+  slot->rewriter = std::make_shared<rtp_rewriter>();
+
+  // By index, the slot goes away when a reconnect rebuilds the pool; the generation check rejects a stale index
+  auto gen = generation;
+  slot->track->onOpen([weak = weak_from_this(), gen, index]() {
+    if (auto self = weak.lock()) self->on_track_open(gen, index);
+  });
+
+  slots.push_back(std::move(slot));
+  return *slots.back();
+}
+
+void peer_link::renegotiate(uint64_t gen) {
+  auto conn = std::shared_ptr<rtc::PeerConnection>{};
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (gen != generation || state != link_state::CONNECTED || !needs_renegotiation) return;
+    needs_renegotiation = false;
+    conn = pc;
+  }
+
+  // New tracks are offered on the existing connection, no new ICE or DTLS handshake
+  LOG_DEBUG(logger, "Renegotiating peer link {}", link_id);
+  conn->setLocalDescription(rtc::Description::Type::Offer);
+}
+
+void peer_link::on_track_open(uint64_t gen, size_t index) {
+  // The callback and what it gets are taken together under the lock and it runs outside of it; a release racing
+  // this is seen by the session itself, a reconnect fails the session through its error callback
+  auto ready = track_ready{};
+  auto track = std::shared_ptr<rtc::Track>{};
+  auto rewriter = std::shared_ptr<rtp_rewriter>{};
+  auto ssrc = uint32_t{0};
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (gen != generation || index >= slots.size() || !slots[index]->on_ready) return;
+
+    auto& slot = *slots[index];
+    ready = std::move(slot.on_ready);
+    slot.on_ready = nullptr;
+    track = slot.track;
+    rewriter = slot.rewriter;
+    ssrc = slot.ssrc;
+  }
+
+  ready(track, ssrc, rewriter);
+}
+
+void peer_link::on_recognition(const std::string& session_id, bool greeted) {
+  auto on_result = result_callback{};
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    auto it = std::find_if(slots.begin(), slots.end(),
+                           [&session_id](const auto& slot) { return slot->session_id == session_id; });
+    if (it == slots.end() || !(*it)->on_result) return;  // the session already ended
+    on_result = (*it)->on_result;
+  }
+
+  on_result(greeted);
+}
+
+void peer_link::fail(uint64_t gen, const std::string& reason) {
+  auto errors = std::vector<std::function<void()>>{};
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (gen != generation || state == link_state::FAILED || state == link_state::CLOSED) return;
+    state = link_state::FAILED;
+
+    // Every bound session loses its track, the pool is rebuilt with the next connection
+    for (auto& slot : slots) {
+      if (slot->session_id.empty()) continue;
+      if (slot->on_error) errors.push_back(std::move(slot->on_error));
+      slot->session_id.clear();
+      slot->on_ready = nullptr;
+      slot->on_error = nullptr;
+      slot->on_result = nullptr;
+    }
+  }
+
+  LOG_ERROR(logger, "Peer link {} failed: {}, {} sessions affected", link_id, reason, errors.size());
+  for (auto& on_error : errors) on_error();
+}
+
+void peer_link::acquire_track(const std::string& session_id, track_ready on_ready, std::function<void()> on_error,
+                              result_callback on_result) {
+  auto old_pc = std::shared_ptr<rtc::PeerConnection>{};
+  auto old_signaling = std::shared_ptr<signaling_client>{};
+  auto conn = std::shared_ptr<rtc::PeerConnection>{};
+  auto ready = track_ready{};
+  auto track = std::shared_ptr<rtc::Track>{};
+  auto rewriter = std::shared_ptr<rtp_rewriter>{};
+  auto ssrc = uint32_t{0};
+  auto gen = uint64_t{0};
+  auto opened = false;
+
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+
+    // Replace a failed connection, its resources are released below outside of the lock
+    if (state == link_state::FAILED) {
+      old_pc = std::move(pc);
+      old_signaling = std::move(signaling);
+      state = link_state::CLOSED;
+    }
+
+    if (state == link_state::CLOSED) {
+      open();
+      opened = true;
+    }
+
+    auto it = std::find_if(slots.begin(), slots.end(), [](const auto& slot) { return slot->session_id.empty(); });
+    auto& slot = it != slots.end() ? **it : add_track();
+    if (it == slots.end()) {
+      needs_renegotiation = true;
+      LOG_INFO(logger, "Track pool of peer link {} exhausted, growing to {}", link_id, slots.size());
+    }
+
+    slot.session_id = session_id;
+    slot.on_error = std::move(on_error);
+    slot.on_result = std::move(on_result);
+    signaling->send_binding(session_id, slot.mid, true);
+
+    // An idle pooled track is already open, the session can start right away
+    if (slot.track->isOpen()) {
+      ready = std::move(on_ready);
+      track = slot.track;
+      ssrc = slot.ssrc;
+      rewriter = slot.rewriter;
+    } else {
+      slot.on_ready = std::move(on_ready);
+    }
+
+    conn = pc;
+    gen = generation;
+    LOG_DEBUG(logger, "Session {} bound to track {} of peer link {}", session_id, slot.mid, link_id);
+  }
+
+  if (old_signaling) old_signaling->detach();
+  if (old_pc) old_pc->close();
+
+  // A new connection sends its first offer, otherwise only renegotiate if connected and stable,
+  // the state change callbacks pick up a renegotiation that has to wait
+  if (opened) {
+    conn->setLocalDescription(rtc::Description::Type::Offer);
+  } else if (conn->signalingState() == rtc::PeerConnection::SignalingState::Stable) {
+    renegotiate(gen);
+  }
+  if (ready) ready(track, ssrc, rewriter);
+}
+
+void peer_link::release_track(const std::string& session_id) {
+  std::lock_guard<std::mutex> lock(mtx);
+  auto it = std::find_if(slots.begin(), slots.end(),
+                         [&session_id](const auto& slot) { return slot->session_id == session_id; });
+  if (it == slots.end()) return;
+
+  auto& slot = **it;
+  if (signaling) signaling->send_binding(session_id, slot.mid, false);
+  slot.session_id.clear();
+  slot.on_ready = nullptr;
+  slot.on_error = nullptr;
+  slot.on_result = nullptr;
+  LOG_DEBUG(logger, "Track {} of peer link {} returned to the pool", slot.mid, link_id);
+}
@@ -0,0 +1,38 @@
+#include "client/sessions/retransmit_history.hpp"
+
+retransmit_history::retransmit_history(size_t capacity) : resent{0}, missed{0} {
+  auto size = size_t{1};
+  while (size < capacity) size <<= 1;
+
+  entries.resize(size);
+  mask = size - 1;
+}
+
+void retransmit_history::store(const packet_ref& packet, uint16_t seq, uint32_t timestamp) {
+  std::lock_guard<std::mutex> lock(mtx);
+  auto& e = entries[seq & mask];
+  if (e.packet.get() == packet.get() && e.seq == seq) return;  // a retransmission of the packet already held
+
+  e.packet = packet;  // releases the packet this slot held before
+  e.seq = seq;
+  e.timestamp = timestamp;
+  e.resent_ns = 0;
+}
+
+packet_ref retransmit_history::find(uint16_t seq, int64_t now_ns, uint32_t& timestamp) {
+  std::lock_guard<std::mutex> lock(mtx);
+  auto& e = entries[seq & mask];
+  if (!e.packet || e.seq != seq) {
+    missed.fetch_add(1, std::memory_order_relaxed);
+    return packet_ref{};
+  }
+
+  // The same loss is often reported by several NACKs in a row, one resend per RTT is enough
+  if (e.resent_ns != 0 && now_ns - e.resent_ns < RESEND_INTERVAL_NS) return packet_ref{};
+
+  e.resent_ns = now_ns;
+  resent.fetch_add(1, std::memory_order_relaxed);
+  timestamp = e.timestamp;
+  return e.packet;
+}
+
@@ -0,0 +1,37 @@
+#include "client/sessions/rtp_rewriter.hpp"
+
+rtp_rewriter::rtp_rewriter()
+    : started{false},
+      rebase{true},
+      last_in_seq{0},
+      seq_offset{0},
+      ts_offset{0},
+      last_out_seq{0},
+      last_out_ts{0} {}
+
+void rtp_rewriter::restart() {
+  std::lock_guard<std::mutex> lock(mtx);
+  rebase = true;
+}
+
+rtp_rewriter::mapping rtp_rewriter::map(uint16_t seq, uint32_t timestamp) {
+  std::lock_guard<std::mutex> lock(mtx);
+  auto delta = static_cast<int16_t>(seq - last_in_seq);
+  if (rebase || delta > MAX_GAP) {
+    // The first packet ever keeps its numbers, later runs continue right after what the track sent
+    seq_offset = started ? static_cast<uint16_t>(last_out_seq + 1 - seq) : 0;
+    ts_offset = started ? last_out_ts + TIMESTAMP_STEP - timestamp : 0;
+    rebase = false;
+    delta = 1;
+  }
+
+  auto out = mapping{static_cast<uint16_t>(seq + seq_offset), timestamp + ts_offset};
+  if (delta > 0 || !started) {
+    // Reordered packets map with the same offset but do not move the end of the run
+    last_in_seq = seq;
+    last_out_seq = out.seq;
+    last_out_ts = out.timestamp;
+  }
+  started = true;
+  return out;
+}
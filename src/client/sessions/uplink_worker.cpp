@@ -0,0 +1,98 @@
+#include "client/sessions/uplink_worker.hpp"
+
+uplink_worker::uplink_worker(size_t capacity, drop_policy policy, sink on_send)
+    : queue(capacity == 0 ? 1 : capacity),
+      head{0},
+      count{0},
+      policy{policy},
+      is_running{true},
+      dropped{0},
+      on_send{std::move(on_send)} {
+  sender_thread = std::thread([this]() { this->send_work(); });
+}
+
+uplink_worker::~uplink_worker() { stop(); }
+
+void uplink_worker::stop() {
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    is_running.store(false);
+  }
+  cv.notify_all();
+
+  if (sender_thread.joinable()) {
+    sender_thread.join();
+  }
+}
+
+bool uplink_worker::push(const packet_ref& packet) {
+  auto accepted = true;
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (count == queue.size()) {
+      dropped.fetch_add(1, std::memory_order_relaxed);
+      if (policy == drop_policy::DROP_NEWEST) return false;
+
+      // Drop the oldest packet to make room
+      queue[head] = packet_ref{};
+      head = (head + 1) % queue.size();
+      --count;
+      accepted = false;
+    }
+
+    queue[(head + count) % queue.size()] = packet;
+    ++count;
+  }
+
+  cv.notify_one();
+  return accepted;
+}
+
+size_t uplink_worker::push(const packet_ref* packets, size_t size) {
+  auto accepted = size_t{0};
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    for (auto i = size_t{0}; i < size; ++i) {
+      if (count == queue.size()) {
+        if (policy == drop_policy::DROP_NEWEST) {
+          dropped.fetch_add(size - i, std::memory_order_relaxed);
+          break;
+        }
+
+        // Drop the oldest packet to make room
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        queue[head] = packet_ref{};
+        head = (head + 1) % queue.size();
+        --count;
+      } else {
+        ++accepted;
+      }
+
+      queue[(head + count) % queue.size()] = packets[i];
+      ++count;
+    }
+  }
+
+  cv.notify_one();
+  return accepted;
+}
+
+void uplink_worker::send_work() {
+  // Take the handle out of the ring so the peer is never called while holding the queue lock
+  auto pending = packet_ref{};
+
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mtx);
+      cv.wait(lock, [this]() { return count > 0 || !is_running.load(); });
+      if (!is_running.load()) break;
+
+      pending = std::move(queue[head]);
+      head = (head + 1) % queue.size();
+      --count;
+    }
+
+    on_send(pending);
+    pending = packet_ref{};  // return the buffer to the pool as soon as it is sent
+  }
+}
@@ -5,4 +5,8 @@ client_state_manager::~client_state_manager() {
   if (camera) {
     camera->stop();
   }
+  // No more events once the camera is down, stop the FSM before the services it uses go away
+  robot.reset();
+  dispatcher.reset();
+  if (rpc_server) rpc_server->Shutdown();
 }
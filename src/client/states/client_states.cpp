@@ -1,7 +1,77 @@
 #include "client/states/client_states.hpp"
 
-std::shared_ptr<generic_camera> bot::camera = nullptr;
-std::shared_ptr<robot_rpc_manager> bot::rpc_manager = nullptr;
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <utility>
 
-// Define the initial state here to avoid multiple definitions
-FSM_INITIAL_STATE(bot, init_state);
+thread_local bot_context* bot::running = nullptr;
+
+bot_context& bot::context() { return *running; }
+
+std::weak_ptr<bot_context> bot::self() { return running->weak_from_this(); }
+
+bool bot::post(const bot_event& event) { return running->post(event); }
+
+bool bot::post(const std::weak_ptr<bot_context>& robot, const bot_event& event) {
+  auto target = robot.lock();
+  return target && target->post(event);
+}
+
+void bot::start(bot_context& robot) {
+  auto previous = std::exchange(running, &robot);
+  bot_transitions::start(robot.state);
+  running = previous;
+}
+
+void bot::dispatch(bot_context& robot, const bot_event& event) {
+  if (event.id == event_id<timeout_event>) {
+    // A deadline that fired while the robot was already leaving its state
+    auto timeout = timeout_event{};
+    std::memcpy(&timeout, event.data, sizeof(timeout));
+    if (timeout.deadline && (timeout.deadline != robot.deadline || !robot.deadline_timer)) {
+      LOG_DEBUG(logger, "[{}::react] dropping stale [timeout_event] of deadline {}", to_string(robot.get_state()),
+                timeout.deadline);
+      return;
+    }
+  }
+
+  auto previous = std::exchange(running, &robot);
+  bot_transitions::dispatch(robot.state, event.id, event.data);
+  running = previous;
+}
+
+void bot::arm_deadline(timer_wheel::clock::duration after) {
+  auto& robot = context();
+  if (++robot.deadline == 0) ++robot.deadline;
+  // A full mailbox must not swallow the timeout, the timer re-arms itself until the post goes through; it learns
+  // its own id once schedule() returns, and a cancel on leaving the state stops the retries
+  auto id = std::make_shared<std::atomic<timer_wheel::timer_id>>(0);
+  robot.deadline_timer = robot.timers->schedule(
+      after, [target = self(), timers = robot.timers, id, deadline = robot.deadline]() {
+        if (!post(target, timeout_event{deadline}) && !target.expired()) timers->rearm(id->load(), DEADLINE_RETRY);
+      });
+  id->store(robot.deadline_timer);
+}
+
+void bot::cancel_deadline() {
+  auto& robot = context();
+  if (robot.deadline_timer) robot.timers->cancel(std::exchange(robot.deadline_timer, 0));
+}
+
+void bot::stop_camera_stream() {
+  auto& robot = context();
+  if (!robot.current_sid.empty()) {
+    robot.rpc_manager->stop_camera_stream(robot.current_sid);
+    robot.current_sid.clear();
+  }
+}
+
+void bot::on_reset(const reset_event&) {
+  LOG_WARNING(logger, "[{}::react] going to idle state after [reset_event]", to_string(context().get_state()));
+}
+
+void bot::on_terminate(const terminate_event&) {
+  LOG_WARNING(logger, "[{}::react] going to terminated state after [terminate_event]",
+              to_string(context().get_state()));
+}
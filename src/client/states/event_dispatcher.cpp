@@ -0,0 +1,180 @@
+#include "client/states/event_dispatcher.hpp"
+
+#include <chrono>
+#include <cstring>
+
+#include "common/chat_utils.hpp"
+
+namespace {
+int64_t steady_now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+}  // namespace
+
+bot_context::bot_context(event_dispatcher& dispatcher, std::shared_ptr<generic_camera> camera,
+                         std::shared_ptr<robot_rpc_manager> rpc_manager)
+    : camera{std::move(camera)},
+      rpc_manager{std::move(rpc_manager)},
+      dispatcher{dispatcher},
+      state{bot_transitions::NONE},
+      mailbox{MAILBOX_CAPACITY},
+      scheduled{false},
+      pending{0},
+      queued_presence{0},
+      timers{timer_wheel::shared()},
+      deadline_timer{0},
+      deadline{0} {}
+
+bot_context::~bot_context() {
+  if (deadline_timer) timers->cancel(deadline_timer);
+}
+
+bool bot_context::post(const bot_event& event) { return dispatcher.post(*this, event); }
+
+client_state bot_context::get_state() const {
+  auto current = state.load(std::memory_order_relaxed);
+  return current < bot_transitions::IDS.size() ? bot_transitions::IDS[current] : client_state::INIT;
+}
+
+event_dispatcher::event_dispatcher(size_t threads)
+    : stopping{false},
+      posted{0},
+      dropped{0},
+      dispatched{0},
+      max_depth{0},
+      mean_latency_us{0},
+      max_latency_us{0} {
+  if (threads == 0) threads = 1;
+  for (size_t i = 0; i < threads; ++i) workers.emplace_back([this]() { this->worker_loop(); });
+}
+
+event_dispatcher::~event_dispatcher() {
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    stopping = true;
+  }
+  ready_cv.notify_all();
+  for (auto& worker : workers) {
+    if (worker.joinable()) worker.join();
+  }
+
+  auto s = get_stats();
+  LOG_INFO(logger, "Event dispatcher stopped: {} posted, {} dropped, {} dispatched, max depth {}, latency {}/{} us",
+           s.posted, s.dropped, s.dispatched, s.max_depth, s.mean_latency_us, s.max_latency_us);
+}
+
+std::shared_ptr<bot_context> event_dispatcher::create(std::shared_ptr<generic_camera> camera,
+                                                      std::shared_ptr<robot_rpc_manager> rpc_manager) {
+  auto robot = std::make_shared<bot_context>(*this, std::move(camera), std::move(rpc_manager));
+  robot->scheduled.store(true);  // the first turn enters the initial state
+  schedule(robot);
+  return robot;
+}
+
+uint8_t event_dispatcher::presence_of(const bot_event& event) {
+  if (event.id != event_id<human_presence_event>) return 0;
+  auto presence = human_presence_event{};
+  std::memcpy(&presence, event.data, sizeof(presence));
+  return presence.present ? 2 : 1;
+}
+
+bool event_dispatcher::post(bot_context& robot, const bot_event& event) {
+  auto presence = presence_of(event);
+  if (presence && robot.queued_presence.exchange(presence, std::memory_order_relaxed) == presence) return true;
+
+  robot.pending.fetch_add(1, std::memory_order_relaxed);  // before the push, the count never runs below the mail
+  if (!robot.mailbox.try_push(bot_context::queued_event{event, steady_now_ns()})) {
+    robot.pending.fetch_sub(1, std::memory_order_relaxed);
+    // Every power of two, a storm of drops does not flood the log
+    auto count = dropped.fetch_add(1, std::memory_order_relaxed) + 1;
+    if ((count & (count - 1)) == 0) {
+      LOG_WARNING(logger, "Robot mailbox full ({} slots), dropped [{}], {} events dropped so far",
+                  robot.mailbox.capacity(), event.name(), count);
+    }
+    if (presence) robot.queued_presence.store(0, std::memory_order_relaxed);
+    return false;
+  }
+
+  auto depth = posted.fetch_add(1, std::memory_order_relaxed) + 1 - dispatched.load(std::memory_order_relaxed);
+  auto seen = max_depth.load(std::memory_order_relaxed);
+  while (depth > seen && !max_depth.compare_exchange_weak(seen, depth, std::memory_order_relaxed)) {
+  }
+
+  // Only the post that finds the robot idle queues it, the lock is taken once per turn rather than per event
+  if (!robot.scheduled.exchange(true, std::memory_order_acq_rel)) schedule(robot.shared_from_this());
+  return true;
+}
+
+void event_dispatcher::schedule(std::shared_ptr<bot_context> robot) {
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    ready.push_back(std::move(robot));
+  }
+  ready_cv.notify_one();
+}
+
+void event_dispatcher::worker_loop() {
+  while (true) {
+    auto robot = std::shared_ptr<bot_context>{};
+    {
+      std::unique_lock<std::mutex> lock(mtx);
+      ready_cv.wait(lock, [this] { return stopping || !ready.empty(); });
+      if (stopping) return;
+      robot = std::move(ready.front());
+      ready.pop_front();
+    }
+    run(*robot);
+  }
+}
+
+void event_dispatcher::run(bot_context& robot) {
+  if (robot.state.load(std::memory_order_relaxed) == bot_transitions::NONE) bot::start(robot);
+
+  auto next = bot_context::queued_event{};
+  for (size_t i = 0; i < BATCH && robot.mailbox.try_pop(next); ++i) {
+    robot.pending.fetch_sub(1, std::memory_order_relaxed);
+    if (auto presence = presence_of(next.event)) {
+      // Reports arriving from now on are newer than this one, unless a different one is queued already
+      robot.queued_presence.compare_exchange_strong(presence, 0, std::memory_order_relaxed);
+    }
+
+    record_latency(next.event, (steady_now_ns() - next.posted_ns) / 1000);
+    bot::dispatch(robot, next.event);
+    dispatched.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // A post racing with this sees the flag cleared and queues the robot itself, otherwise its pending count is seen
+  // here: it was raised before that post's exchange on the flag. The mailbox itself is not read again, once the
+  // flag is cleared another worker may already be popping it
+  robot.scheduled.exchange(false, std::memory_order_acq_rel);
+  if (robot.pending.load(std::memory_order_relaxed) > 0 && !robot.scheduled.exchange(true, std::memory_order_acq_rel)) {
+    schedule(robot.shared_from_this());
+  }
+}
+
+void event_dispatcher::record_latency(const bot_event& event, int64_t latency_us) {
+  // Workers race on the average, it is a trend and not an exact figure
+  auto mean = mean_latency_us.load(std::memory_order_relaxed);
+  mean_latency_us.store(mean + (latency_us - mean) / 16, std::memory_order_relaxed);
+  auto seen = max_latency_us.load(std::memory_order_relaxed);
+  while (latency_us > seen && !max_latency_us.compare_exchange_weak(seen, latency_us, std::memory_order_relaxed)) {
+  }
+
+  if (latency_us > LATENCY_WARNING_US) {
+    LOG_WARNING(logger, "Event [{}] waited {} us for a dispatcher worker, a state is blocking the FSM", event.name(),
+                latency_us);
+  }
+}
+
+auto event_dispatcher::get_stats() const -> stats {
+  auto out = stats{};
+  out.posted = posted.load(std::memory_order_relaxed);
+  out.dropped = dropped.load(std::memory_order_relaxed);
+  out.dispatched = dispatched.load(std::memory_order_relaxed);
+  out.depth = out.posted > out.dispatched ? out.posted - out.dispatched : 0;
+  out.max_depth = max_depth.load(std::memory_order_relaxed);
+  out.mean_latency_us = mean_latency_us.load(std::memory_order_relaxed);
+  out.max_latency_us = max_latency_us.load(std::memory_order_relaxed);
+  return out;
+}
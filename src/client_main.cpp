@@ -1,4 +1,6 @@
 #include <chrono>
+#include <iostream>
+#include <string>
 #include <thread>
 
 #include "client/states/client_state_manager.hpp"
@@ -9,6 +11,12 @@ using namespace grpc;
 using namespace std::chrono_literals;
 
 int main(int argc, char* argv[]) {
+  // Prints the bot state machine as Graphviz source, e.g. ./client --fsm-dot | dot -Tsvg > fsm.svg
+  if (argc > 1 && std::string{argv[1]} == "--fsm-dot") {
+    std::cout << bot_transitions::to_dot("bot");
+    return 0;
+  }
+
   logger = std::shared_ptr<quill::Logger>{
       quill::Frontend::create_or_get_logger(getenv("USER") ? getenv("USER") : "unknown_user",
                                             quill::Frontend::create_or_get_sink<quill::ConsoleSink>("sink_client"))};
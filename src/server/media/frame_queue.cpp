@@ -0,0 +1,71 @@
+#include "server/media/frame_queue.hpp"
+
+frame_queue::lease &frame_queue::lease::operator=(lease &&other) noexcept {
+  if (this != &other) {
+    release();
+    owner = other.owner;
+    item = other.item;
+    other.owner = nullptr;
+  }
+  return *this;
+}
+
+void frame_queue::lease::release() {
+  if (!owner) return;
+  owner->advance_tail();
+  owner = nullptr;
+}
+
+frame_queue::frame_queue(size_t count, size_t frame_capacity, std::function<void()> on_commit)
+    : head{0}, tail{0}, next_read{0}, waiting{false}, on_commit{std::move(on_commit)} {
+  auto size = size_t{1};
+  while (size < count) size <<= 1;
+
+  frames.resize(size);
+  mask = size - 1;
+  for (auto &f : frames) {
+    f.data = std::make_unique<uint8_t[]>(frame_capacity);
+    f.capacity = frame_capacity;
+  }
+}
+
+frame *frame_queue::begin_write() {
+  auto h = head.load(std::memory_order_relaxed);
+  if (h - tail.load(std::memory_order_acquire) == frames.size()) return nullptr;
+
+  auto &f = frames[h & mask];
+  f.size = 0;
+  f.rtp_timestamp = 0;
+  f.rx_time_ns = 0;
+  f.is_keyframe = false;
+  f.is_reference = false;
+  f.sampled = true;
+  return &f;
+}
+
+void frame_queue::commit() {
+  head.store(head.load(std::memory_order_relaxed) + 1);  // seq_cst, pairs with the waiting flag
+
+  if (waiting.load()) {
+    std::lock_guard<std::mutex> lock(wait_mtx);
+    wait_cv.notify_one();
+  }
+
+  if (on_commit) on_commit();
+}
+
+frame_queue::lease frame_queue::try_pop() {
+  if (next_read == head.load(std::memory_order_acquire)) return lease{};
+  return lease{this, &frames[next_read++ & mask]};
+}
+
+frame_queue::lease frame_queue::pop(std::chrono::milliseconds timeout) {
+  if (auto item = try_pop()) return item;
+
+  std::unique_lock<std::mutex> lock(wait_mtx);
+  waiting.store(true);  // seq_cst, a commit after this store sees it and notifies
+  wait_cv.wait_for(lock, timeout, [this]() { return next_read != head.load(std::memory_order_acquire); });
+  waiting.store(false);
+
+  return try_pop();
+}
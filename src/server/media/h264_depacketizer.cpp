@@ -0,0 +1,405 @@
+#include "server/media/h264_depacketizer.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include "common/rtp/h264.hpp"
+
+namespace {
+constexpr uint8_t START_CODE[] = {0x00, 0x00, 0x00, 0x01};
+constexpr int64_t NS_PER_MS = 1'000'000;
+}  // namespace
+
+h264_depacketizer::h264_depacketizer(uint8_t payload_type, std::shared_ptr<frame_queue> frames,
+                                     jitter_profile profile, feedback fb, ingest_config ingest)
+    : payload_type{payload_type},
+      profile{profile},
+      frames{std::move(frames)},
+      fb{std::move(fb)},
+      ingest{ingest},
+      window{std::make_unique<std::array<slot, WINDOW>>()},
+      buffered{0},
+      has_expected{false},
+      expected{0},
+      highest{0},
+      pending_gap{false},
+      media_ssrc{0},
+      jitter_ns{0},
+      recovery_ns{profile.max_wait_ms * NS_PER_MS / 2},
+      last_transit_ns{0},
+      has_transit{false},
+      current{nullptr},
+      in_access_unit{false},
+      damaged{false},
+      in_fragment{false},
+      current_timestamp{0},
+      awaiting_keyframe{profile.drop_until_keyframe},
+      consumed{true},
+      was_consumed{true},
+      last_keyframe_request_ns{-KEYFRAME_REQUEST_INTERVAL_NS},
+      now_ns{0},
+      packets{0},
+      lost{0},
+      late{0},
+      reordered{0},
+      recovered{0},
+      nacks{0},
+      keyframe_requests{0},
+      delivered{0},
+      damaged_frames{0},
+      skipped_frames{0},
+      dropped_frames{0},
+      filtered_frames{0},
+      budget_ns{profile.min_wait_ms * NS_PER_MS} {
+  nack_list.reserve(WINDOW);
+}
+
+void h264_depacketizer::push(const void* data, size_t len, int64_t rx_time_ns) {
+  packets.fetch_add(1, std::memory_order_relaxed);
+
+  auto rtp = rtp_view{};
+  if (!rtp_view::parse(data, len, rtp) || rtp.payload_type != payload_type) return;
+  now_ns = rx_time_ns;
+
+  if (!has_expected) {
+    has_expected = true;
+    expected = rtp.seq;
+    highest = static_cast<uint16_t>(rtp.seq - 1);
+    media_ssrc = rtp.ssrc;
+  }
+
+  // Already assembled or given up on
+  if (seq_before(rtp.seq, expected)) {
+    late.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  auto distance = static_cast<uint16_t>(rtp.seq - expected);
+
+  // Too far ahead to buffer (outage or sender restart), flush what we have and resync on this packet
+  if (distance >= WINDOW) {
+    while (buffered > 0) skip_hole();
+    lost.fetch_add(static_cast<uint16_t>(rtp.seq - expected), std::memory_order_relaxed);
+    reset_window();
+    expected = rtp.seq;
+    highest = rtp.seq;
+    media_ssrc = rtp.ssrc;
+    has_transit = false;
+    pending_gap = true;
+
+    assemble(rtp, rx_time_ns);
+    ++expected;
+    return;
+  }
+
+  auto& s = (*window)[rtp.seq & (WINDOW - 1)];
+  if (s.used) {
+    late.fetch_add(1, std::memory_order_relaxed);  // duplicate
+    return;
+  }
+
+  note_arrival(s, rtp.seq, rx_time_ns);
+
+  // Everything between the newest packet so far and this one is a new hole
+  if (seq_before(highest, rtp.seq)) {
+    update_jitter(rtp, rx_time_ns);
+    mark_missing(static_cast<uint16_t>(highest + 1), rtp.seq);
+    highest = rtp.seq;
+  }
+
+  if (distance == 0) {
+    // In order, assemble straight from the network buffer
+    assemble(rtp, rx_time_ns);
+    ++expected;
+    drain();
+  } else if (len <= SLOT_SIZE) {
+    std::memcpy(s.data.data(), data, len);
+    s.used = true;
+    s.seq = rtp.seq;
+    s.len = len;
+    s.rx_time_ns = rx_time_ns;
+    ++buffered;
+    reordered.fetch_add(1, std::memory_order_relaxed);
+  }  // else it cannot be buffered and stays a hole
+
+  service_holes();
+}
+
+void h264_depacketizer::update_jitter(const rtp_view& rtp, int64_t rx_time_ns) {
+  // RFC 3550 interarrival jitter, J += (|D| - J) / 16, kept in nanoseconds
+  auto transit = rx_time_ns - static_cast<int64_t>(rtp.timestamp) * 1'000'000'000 / CLOCK_RATE;
+  if (has_transit) jitter_ns += (std::llabs(transit - last_transit_ns) - jitter_ns) / 16;
+  last_transit_ns = transit;
+  has_transit = true;
+}
+
+void h264_depacketizer::note_arrival(slot& s, uint16_t seq, int64_t rx_time_ns) {
+  if (!s.missing || s.seq != seq) return;
+  s.missing = false;
+
+  if (s.nacks > 0) {
+    // Learn how long a hole takes to fill, the wait budget follows it
+    recovered.fetch_add(1, std::memory_order_relaxed);
+    recovery_ns += (rx_time_ns - s.first_missing_ns - recovery_ns) / 8;
+  }
+}
+
+void h264_depacketizer::mark_missing(uint16_t from, uint16_t to) {
+  for (auto seq = from; seq != to; ++seq) {
+    auto& m = (*window)[seq & (WINDOW - 1)];
+    m.missing = true;
+    m.seq = seq;
+    m.first_missing_ns = now_ns;
+    m.last_nack_ns = 0;
+    m.nacks = 0;
+  }
+}
+
+void h264_depacketizer::service_holes() {
+  if (buffered == 0) return;  // holes only exist behind a buffered packet
+
+  auto budget = std::clamp(recovery_ns * 3 / 2 + 2 * jitter_ns, profile.min_wait_ms * NS_PER_MS,
+                           profile.max_wait_ms * NS_PER_MS);
+  budget_ns.store(budget, std::memory_order_relaxed);
+
+  // Give up on holes that waited out the budget, the frames behind them can still be delivered
+  while (buffered > 0) {
+    auto& head = (*window)[expected & (WINDOW - 1)];
+    if (head.missing && now_ns - head.first_missing_ns < budget) break;
+    skip_hole();
+  }
+
+  if (buffered == 0 || profile.max_nacks == 0 || !fb.send_nack) return;
+
+  // Request what is still missing, retries are spaced by the observed recovery delay
+  auto retry = std::max(NACK_RETRY_FLOOR_NS, recovery_ns);
+  nack_list.clear();
+  for (auto seq = expected; seq != highest; ++seq) {
+    auto& m = (*window)[seq & (WINDOW - 1)];
+    if (!m.missing || m.seq != seq || m.nacks >= profile.max_nacks) continue;
+    if (m.nacks > 0 && now_ns - m.last_nack_ns < retry) continue;
+
+    ++m.nacks;
+    m.last_nack_ns = now_ns;
+    nack_list.push_back(seq);
+  }
+
+  if (!nack_list.empty()) {
+    nacks.fetch_add(nack_list.size(), std::memory_order_relaxed);
+    fb.send_nack(media_ssrc, nack_list.data(), nack_list.size());
+  }
+}
+
+void h264_depacketizer::drain() {
+  while (buffered > 0) {
+    auto& s = (*window)[expected & (WINDOW - 1)];
+    if (!s.used || s.seq != expected) return;
+
+    auto rtp = rtp_view{};
+    rtp_view::parse(s.data.data(), s.len, rtp);  // validated before it was buffered
+    assemble(rtp, s.rx_time_ns);
+
+    s.used = false;
+    --buffered;
+    ++expected;
+  }
+}
+
+void h264_depacketizer::skip_hole() {
+  if (buffered == 0) return;
+
+  // Give up on everything missing up to the oldest buffered packet
+  while (!(*window)[expected & (WINDOW - 1)].used) {
+    (*window)[expected & (WINDOW - 1)].missing = false;
+    lost.fetch_add(1, std::memory_order_relaxed);
+    ++expected;
+  }
+
+  pending_gap = true;
+  drain();
+}
+
+void h264_depacketizer::reset_window() {
+  for (auto& s : *window) {
+    s.used = false;
+    s.missing = false;
+  }
+  buffered = 0;
+}
+
+void h264_depacketizer::request_keyframe() {
+  if (!fb.request_keyframe || now_ns - last_keyframe_request_ns < KEYFRAME_REQUEST_INTERVAL_NS) return;
+
+  last_keyframe_request_ns = now_ns;
+  keyframe_requests.fetch_add(1, std::memory_order_relaxed);
+  fb.request_keyframe();
+}
+
+void h264_depacketizer::assemble(const rtp_view& rtp, int64_t rx_time_ns) {
+  auto gap = pending_gap;
+  pending_gap = false;
+
+  if (gap) {
+    damaged = true;  // the hole belonged to the current access unit or to the start of the next one
+    in_fragment = false;
+  }
+
+  // A new timestamp without a marker on the previous access unit means its last packet was lost
+  if (!in_access_unit || rtp.timestamp != current_timestamp) {
+    if (in_access_unit) {
+      damaged = true;
+      end_access_unit();
+    }
+    begin_access_unit(rtp.timestamp, rx_time_ns);
+    damaged = gap;
+  }
+
+  if (rtp.payload_len == 0) return;
+
+  auto type = rtp.payload[0] & 0x1F;
+  if (type >= 1 && type <= 23) {
+    if (in_fragment) damaged = true;  // fragment never finished
+    in_fragment = false;
+    append_nal(rtp.payload, rtp.payload_len);
+  } else if (type == h264::NAL_STAP_A) {
+    // [STAP-A header][size16][NALU][size16][NALU]...
+    for (size_t offset = 1; offset + 2 < rtp.payload_len;) {
+      auto size = (static_cast<size_t>(rtp.payload[offset]) << 8) | rtp.payload[offset + 1];
+      offset += 2;
+      if (size == 0 || offset + size > rtp.payload_len) {
+        damaged = true;
+        break;
+      }
+      append_nal(rtp.payload + offset, size);
+      offset += size;
+    }
+  } else if (type == h264::NAL_FU_A) {
+    if (rtp.payload_len < 2) {
+      damaged = true;
+    } else {
+      auto fu_start = (rtp.payload[1] & 0x80) != 0;
+      auto fu_end = (rtp.payload[1] & 0x40) != 0;
+
+      if (fu_start) {
+        if (in_fragment) damaged = true;
+        // Rebuild the original NAL header from the FU indicator (F, NRI) and the FU header (type)
+        auto header = static_cast<uint8_t>((rtp.payload[0] & 0xE0) | (rtp.payload[1] & 0x1F));
+        append_nal(&header, 1);
+        in_fragment = true;
+      } else if (!in_fragment) {
+        damaged = true;  // the start fragment was lost
+      }
+
+      if (in_fragment) append(rtp.payload + 2, rtp.payload_len - 2);
+      if (fu_end) in_fragment = false;
+    }
+  }
+
+  if (rtp.marker) end_access_unit();
+}
+
+void h264_depacketizer::begin_access_unit(uint32_t timestamp, int64_t rx_time_ns) {
+  in_access_unit = true;
+  in_fragment = false;
+  current_timestamp = timestamp;
+
+  if (!consumed.load(std::memory_order_relaxed)) {
+    was_consumed = false;
+    current = nullptr;
+    filtered_frames.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  // The chain broke while nobody was reading, the new reader starts from an IDR
+  if (!was_consumed) {
+    was_consumed = true;
+    ingest.break_chain();
+    if (profile.drop_until_keyframe) awaiting_keyframe = true;
+    request_keyframe();
+  }
+
+  current = frames->begin_write();
+  if (!current) {
+    // The consumer misses this frame, anything referencing it is broken too
+    dropped_frames.fetch_add(1, std::memory_order_relaxed);
+    ingest.break_chain();
+    if (profile.drop_until_keyframe) awaiting_keyframe = true;
+    request_keyframe();
+    return;
+  }
+
+  current->rtp_timestamp = timestamp;
+  current->rx_time_ns = rx_time_ns;
+}
+
+void h264_depacketizer::end_access_unit() {
+  if (current) {
+    // Uncommitted frames are reused by the next access unit
+    if (damaged || in_fragment || current->size == 0) {
+      damaged_frames.fetch_add(1, std::memory_order_relaxed);
+      ingest.break_chain();
+      if (profile.drop_until_keyframe) awaiting_keyframe = true;
+      request_keyframe();
+    } else if (awaiting_keyframe && !current->is_keyframe) {
+      skipped_frames.fetch_add(1, std::memory_order_relaxed);
+      request_keyframe();
+    } else {
+      awaiting_keyframe = false;
+      auto decision = ingest.admit(*current);
+      if (ingest.take_keyframe_request()) request_keyframe();
+
+      if (decision == ingest_policy::decision::DROP) {
+        filtered_frames.fetch_add(1, std::memory_order_relaxed);
+      } else {
+        current->sampled = decision == ingest_policy::decision::SAMPLE;
+        delivered.fetch_add(1, std::memory_order_relaxed);
+        frames->commit();
+      }
+    }
+  }
+
+  current = nullptr;
+  in_access_unit = false;
+  in_fragment = false;
+  damaged = false;
+}
+
+void h264_depacketizer::append_nal(const uint8_t* nal, size_t len) {
+  auto type = nal[0] & 0x1F;
+  if (current && type == h264::NAL_IDR) current->is_keyframe = true;
+  if (current && type >= 1 && type <= h264::NAL_IDR && (nal[0] & 0x60) != 0) current->is_reference = true;
+  append(START_CODE, sizeof(START_CODE));
+  append(nal, len);
+}
+
+void h264_depacketizer::append(const uint8_t* data, size_t len) {
+  if (!current) return;
+
+  if (current->size + len > current->capacity) {
+    damaged = true;
+    return;
+  }
+
+  std::memcpy(current->data.get() + current->size, data, len);
+  current->size += len;
+}
+
+auto h264_depacketizer::get_stats() const -> stats {
+  auto out = stats{};
+  out.packets = packets.load(std::memory_order_relaxed);
+  out.lost = lost.load(std::memory_order_relaxed);
+  out.late = late.load(std::memory_order_relaxed);
+  out.reordered = reordered.load(std::memory_order_relaxed);
+  out.recovered = recovered.load(std::memory_order_relaxed);
+  out.nacks = nacks.load(std::memory_order_relaxed);
+  out.keyframe_requests = keyframe_requests.load(std::memory_order_relaxed);
+  out.frames = delivered.load(std::memory_order_relaxed);
+  out.frames_damaged = damaged_frames.load(std::memory_order_relaxed);
+  out.frames_skipped = skipped_frames.load(std::memory_order_relaxed);
+  out.frames_dropped = dropped_frames.load(std::memory_order_relaxed);
+  out.frames_filtered = filtered_frames.load(std::memory_order_relaxed);
+  out.wait_budget_us = budget_ns.load(std::memory_order_relaxed) / 1000;
+  out.jitter_us = jitter_ns / 1000;  // written by push() only, an approximate read is fine for stats
+  return out;
+}
@@ -0,0 +1,86 @@
+#include "server/media/ingest_policy.hpp"
+
+ingest_policy::ingest_policy(ingest_config config)
+    : config{config},
+      interval{config.rate > 0 ? CLOCK_RATE / config.rate : 0},
+      chain_intact{false},
+      has_sampled{false},
+      since_sample{0},
+      next_due{0},
+      keyframe_wanted{false} {
+  if (this->config.mode == ingest_mode::EVERY_NTH && this->config.rate == 0) this->config.rate = 1;
+}
+
+bool ingest_policy::is_due(const frame& f) const {
+  if (!has_sampled) return true;
+
+  switch (config.mode) {
+    case ingest_mode::EVERY_NTH:
+      return since_sample + 1 >= config.rate;
+    case ingest_mode::MAX_FPS:
+      return static_cast<int32_t>(f.rtp_timestamp - next_due) >= 0;
+    default:
+      return true;
+  }
+}
+
+void ingest_policy::sampled(const frame& f) {
+  // Keep the average rate on cadence, but do not burst to catch up after a long gap
+  if (config.mode == ingest_mode::MAX_FPS) {
+    next_due = has_sampled && static_cast<int32_t>(f.rtp_timestamp - next_due) < static_cast<int32_t>(interval)
+                   ? next_due + interval
+                   : f.rtp_timestamp + interval;
+  }
+
+  has_sampled = true;
+  since_sample = 0;
+}
+
+ingest_policy::decision ingest_policy::admit(const frame& f) {
+  if (config.mode == ingest_mode::ALL) return decision::SAMPLE;
+
+  auto due = config.mode == ingest_mode::KEYFRAMES_ONLY || is_due(f);
+
+  // An IDR starts a new chain, it is the cheapest point to resume sampling
+  if (f.is_keyframe) {
+    if (due) {
+      chain_intact = true;
+      sampled(f);
+      return decision::SAMPLE;
+    }
+
+    ++since_sample;
+    chain_intact = config.decode_references;
+    return chain_intact ? decision::REFERENCE : decision::DROP;
+  }
+
+  if (config.mode == ingest_mode::KEYFRAMES_ONLY) {
+    if (config.request_keyframes && has_sampled) keyframe_wanted = true;
+    return decision::DROP;
+  }
+
+  ++since_sample;
+
+  if (due) {
+    if (chain_intact) {
+      sampled(f);
+      return decision::SAMPLE;
+    }
+
+    // Undecodable, the sample stays due until the next IDR
+    if (config.request_keyframes) keyframe_wanted = true;
+    return decision::DROP;
+  }
+
+  if (!f.is_reference) return decision::DROP;  // nothing depends on it
+  if (config.decode_references && chain_intact) return decision::REFERENCE;
+
+  chain_intact = false;
+  return decision::DROP;
+}
+
+bool ingest_policy::take_keyframe_request() {
+  auto wanted = keyframe_wanted;
+  keyframe_wanted = false;
+  return wanted;
+}
@@ -0,0 +1,24 @@
+#include "server/media/rtcp_feedback_sender.hpp"
+
+#include <utility>
+
+bool rtcp_feedback_sender::queue(rtc::binary packet) {
+  std::lock_guard<std::mutex> lock(mtx);
+  if (pending.size() >= MAX_PENDING) return false;
+  pending.push_back(std::move(packet));
+  has_pending.store(true, std::memory_order_release);
+  return true;
+}
+
+void rtcp_feedback_sender::incoming(rtc::message_vector& messages, const rtc::message_callback& send) {
+  if (!has_pending.load(std::memory_order_acquire)) return;
+
+  auto packets = std::vector<rtc::binary>{};
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    packets.swap(pending);
+    has_pending.store(false, std::memory_order_relaxed);
+  }
+
+  for (auto& packet : packets) send(rtc::make_message(std::move(packet), rtc::Message::Control));
+}
@@ -0,0 +1,36 @@
+#include <cmath>
+#include <functional>
+#include <thread>
+
+#include "server/recognition/recognition_backend.hpp"
+
+cpu_stub_backend::cpu_stub_backend(size_t batch_limit, std::chrono::microseconds batch_cost,
+                                   std::chrono::microseconds frame_cost)
+    : batch_limit{batch_limit == 0 ? 1 : batch_limit}, batch_cost{batch_cost}, frame_cost{frame_cost} {}
+
+void cpu_stub_backend::infer(const recognition_input* inputs, size_t count, recognition_output* outputs) {
+  for (size_t i = 0; i < count; ++i) {
+    auto& out = outputs[i];
+    out = recognition_output{};
+    if (!inputs[i].image->sampled) continue;
+
+    // Same session, same face: a stable pseudo-random unit vector seeded by the session id
+    auto state = static_cast<uint64_t>(std::hash<std::string>{}(*inputs[i].session_id)) | 1;
+    auto norm = 0.0f;
+    for (auto& v : out.embedding) {
+      state ^= state << 13;
+      state ^= state >> 7;
+      state ^= state << 17;
+      v = static_cast<float>(static_cast<int64_t>(state % 2001) - 1000);
+      norm += v * v;
+    }
+    norm = std::sqrt(norm);
+    for (auto& v : out.embedding) v /= norm;
+
+    out.has_face = true;
+    out.confidence = 0.99f;
+  }
+
+  // Cost shape of a real batched model, a fixed launch overhead plus a small per-frame part
+  std::this_thread::sleep_for(batch_cost + frame_cost * count);
+}
@@ -0,0 +1,526 @@
+#include "server/recognition/face_index.hpp"
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <stdexcept>
+
+#include "common/chat_utils.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FACE_INDEX_X86 1
+#endif
+
+namespace {
+
+void score_f32_scalar(const float* matrix, size_t rows, const float* query, float* scores) {
+  for (size_t r = 0; r < rows; ++r, matrix += EMBEDDING_DIM) {
+    auto sum = 0.0f;
+    for (size_t i = 0; i < EMBEDDING_DIM; ++i) sum += matrix[i] * query[i];
+    scores[r] = sum;
+  }
+}
+
+void score_i8_scalar(const int8_t* matrix, size_t rows, const int8_t* query, float* scores) {
+  for (size_t r = 0; r < rows; ++r, matrix += EMBEDDING_DIM) {
+    auto sum = int32_t{0};
+    for (size_t i = 0; i < EMBEDDING_DIM; ++i) sum += int32_t{matrix[i]} * int32_t{query[i]};
+    scores[r] = static_cast<float>(sum);
+  }
+}
+
+#ifdef FACE_INDEX_X86
+
+// EMBEDDING_DIM is a multiple of 64, no tails
+
+__attribute__((target("avx2,fma"))) void score_f32_avx2(const float* matrix, size_t rows, const float* query,
+                                                         float* scores) {
+  for (size_t r = 0; r < rows; ++r, matrix += EMBEDDING_DIM) {
+    auto acc0 = _mm256_setzero_ps();
+    auto acc1 = _mm256_setzero_ps();
+    for (size_t i = 0; i < EMBEDDING_DIM; i += 16) {
+      acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(matrix + i), _mm256_loadu_ps(query + i), acc0);
+      acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(matrix + i + 8), _mm256_loadu_ps(query + i + 8), acc1);
+    }
+    auto acc = _mm256_add_ps(acc0, acc1);
+    auto half = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+    half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 1));
+    scores[r] = _mm_cvtss_f32(half);
+  }
+}
+
+__attribute__((target("avx2"))) void score_i8_avx2(const int8_t* matrix, size_t rows, const int8_t* query,
+                                                    float* scores) {
+  for (size_t r = 0; r < rows; ++r, matrix += EMBEDDING_DIM) {
+    auto acc = _mm256_setzero_si256();
+    for (size_t i = 0; i < EMBEDDING_DIM; i += 16) {
+      // Widen to 16 bits, madd multiplies and sums pairs into 32 bit lanes without overflow
+      auto a = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(matrix + i)));
+      auto b = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(query + i)));
+      acc = _mm256_add_epi32(acc, _mm256_madd_epi16(a, b));
+    }
+    auto half = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0x4E));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0xB1));
+    scores[r] = static_cast<float>(_mm_cvtsi128_si32(half));
+  }
+}
+
+__attribute__((target("avx512f"))) void score_f32_avx512(const float* matrix, size_t rows, const float* query,
+                                                          float* scores) {
+  for (size_t r = 0; r < rows; ++r, matrix += EMBEDDING_DIM) {
+    auto acc0 = _mm512_setzero_ps();
+    auto acc1 = _mm512_setzero_ps();
+    for (size_t i = 0; i < EMBEDDING_DIM; i += 32) {
+      acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(matrix + i), _mm512_loadu_ps(query + i), acc0);
+      acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(matrix + i + 16), _mm512_loadu_ps(query + i + 16), acc1);
+    }
+    scores[r] = _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1));
+  }
+}
+
+__attribute__((target("avx512f,avx512bw"))) void score_i8_avx512(const int8_t* matrix, size_t rows,
+                                                                  const int8_t* query, float* scores) {
+  for (size_t r = 0; r < rows; ++r, matrix += EMBEDDING_DIM) {
+    auto acc = _mm512_setzero_si512();
+    for (size_t i = 0; i < EMBEDDING_DIM; i += 32) {
+      auto a = _mm512_cvtepi8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(matrix + i)));
+      auto b = _mm512_cvtepi8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(query + i)));
+      acc = _mm512_add_epi32(acc, _mm512_madd_epi16(a, b));
+    }
+    scores[r] = static_cast<float>(_mm512_reduce_add_epi32(acc));
+  }
+}
+
+#endif
+
+int8_t quantize(float v, float scale) {
+  return static_cast<int8_t>(std::clamp(std::lround(v * scale), -127l, 127l));
+}
+
+}  // namespace
+
+face_index::face_index(index_precision precision, size_t capacity, int64_t ttl_ns, std::string directory)
+    : precision{precision},
+      segment_capacity{static_cast<uint32_t>(capacity)},
+      ttl_ns{ttl_ns},
+      directory{std::move(directory)},
+      owns_store{false},
+      next_id{1},
+      next_sequence{1},
+      score_f32{score_f32_scalar},
+      score_i8{score_i8_scalar},
+      kernel_name{"scalar"},
+      compaction_requested{false},
+      stopping{false},
+      compaction_now_ns{0},
+      lock_fd{-1} {
+  static_assert(EMBEDDING_DIM % 64 == 0, "SIMD kernels assume whole 64 element blocks");
+
+  // Runtime dispatch, the binary is built for the baseline ISA
+#ifdef FACE_INDEX_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) {
+    score_f32 = score_f32_avx512;
+    score_i8 = score_i8_avx512;
+    kernel_name = "avx512";
+  } else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    score_f32 = score_f32_avx2;
+    score_i8 = score_i8_avx2;
+    kernel_name = "avx2";
+  }
+#endif
+
+  scores.resize(capacity);
+  query_i8.resize(EMBEDDING_DIM);
+  row_i8.resize(EMBEDDING_DIM);
+
+  if (!this->directory.empty()) load();
+  compaction_thread = std::thread(&face_index::compaction_loop, this);
+}
+
+face_index::~face_index() {
+  {
+    std::lock_guard<std::mutex> lock(compaction_mtx);
+    stopping = true;
+  }
+  compaction_cv.notify_one();
+  if (compaction_thread.joinable()) compaction_thread.join();
+
+  if (!segments.empty()) segments.back()->flush();
+  if (lock_fd >= 0) ::close(lock_fd);  // releases the store to the next process
+}
+
+bool face_index::lock_store() {
+  auto path = (std::filesystem::path(directory) / LOCK_FILE).string();
+  lock_fd = ::open(path.c_str(), O_CREAT | O_RDWR | O_CLOEXEC, 0644);
+  if (lock_fd >= 0 && ::flock(lock_fd, LOCK_EX | LOCK_NB) == 0) return true;
+
+  if (lock_fd >= 0) ::close(lock_fd);
+  lock_fd = -1;
+  return false;
+}
+
+void face_index::load() {
+  std::filesystem::create_directories(directory);
+
+  // One writer per store: during a rolling deployment the old process keeps appending to and compacting its files
+  // until it exits, the new one serves them read-only meanwhile instead of racing it
+  owns_store = lock_store();
+  if (!owns_store) {
+    LOG_WARNING(logger, "Face store {} is in use by another process, serving it read-only until it is released",
+                directory);
+  }
+  segments = map_store(!owns_store);
+
+  auto rows = size_t{0};
+  for (const auto& segment : segments) {
+    next_id = std::max(next_id, segment->get_max_id() + 1);
+    rows = std::max(rows, segment->capacity());
+  }
+  if (!segments.empty()) next_sequence = segments.back()->get_sequence() + 1;
+  if (rows > scores.size()) scores.resize(rows);
+
+  // Only the newest segment keeps taking appends
+  for (size_t i = 0; owns_store && i + 1 < segments.size(); ++i) {
+    if (!segments[i]->is_sealed()) segments[i]->seal();
+  }
+
+  LOG_INFO(logger, "Mapped {} face segments from {}, {} rows", segments.size(), directory, size());
+}
+
+std::vector<std::shared_ptr<face_segment>> face_index::map_store(bool read_only) {
+  namespace fs = std::filesystem;
+  std::vector<std::shared_ptr<face_segment>> mapped;
+  for (const auto& entry : fs::directory_iterator(directory)) {
+    const auto& path = entry.path();
+    if (path.extension() == ".tmp") {
+      // Output of a compaction that did not finish, its inputs are still there; the owner's may still be running
+      if (!read_only) fs::remove(path);
+      continue;
+    }
+    if (path.extension() != SEGMENT_SUFFIX) continue;
+
+    // Files of another layout version stay on disk untouched, an older binary rolled back to can still use them
+    // A file that cannot be mapped is skipped as well, the rest of the store still serves
+    try {
+      auto segment = face_segment::open(path.string(), precision, read_only);
+      if (segment) mapped.push_back(std::move(segment));
+    } catch (const std::exception& e) {
+      LOG_ERROR(logger, "Skipping face segment {}: {}", path.string(), e.what());
+    }
+  }
+
+  std::sort(mapped.begin(), mapped.end(),
+            [](const auto& a, const auto& b) { return a->get_sequence() < b->get_sequence(); });
+  return mapped;
+}
+
+void face_index::take_over_store() {
+  // The files as the previous owner left them, its compactions may have replaced the ones mapped at startup
+  auto mapped = map_store(false);
+
+  std::lock_guard<std::mutex> lock(mtx);
+  std::vector<std::shared_ptr<face_segment>> in_memory;
+  for (const auto& segment : segments) {
+    if (!segment->is_read_only()) {
+      in_memory.push_back(segment);
+      continue;
+    }
+    // Keep the refreshes made here while the file was read-only, rows are append-only so they line up
+    for (const auto& file : mapped) {
+      if (file->get_sequence() != segment->get_sequence()) continue;
+      for (size_t r = 0, rows = std::min(segment->size(), file->size()); r < rows; ++r) {
+        if (segment->expiry(r) > file->expiry(r)) file->set_expiry(r, segment->expiry(r));
+      }
+      break;
+    }
+  }
+
+  auto max_id = uint64_t{0};
+  auto rows = size_t{0};
+  for (const auto& segment : mapped) {
+    max_id = std::max(max_id, segment->get_max_id());
+    rows = std::max(rows, segment->capacity());
+  }
+  if (!mapped.empty()) next_sequence = std::max(next_sequence.load(), mapped.back()->get_sequence() + 1);
+  if (rows > scores.size()) scores.resize(rows);
+
+  segments = std::move(mapped);
+  for (size_t i = 0; i + 1 < segments.size(); ++i) {
+    if (!segments[i]->is_sealed()) segments[i]->seal();
+  }
+  owns_store = true;
+
+  // Identities gathered in memory get ids past the previous owner's, it kept handing out the same ones meanwhile
+  // A row that cannot be persisted keeps its memory segment, a copy already persisted expires on its own
+  next_id = max_id + 1;
+  auto persisted = size_t{0};
+  for (const auto& segment : in_memory) {
+    auto r = size_t{0};
+    auto count = segment->size();
+    while (r < count && append(segment->expiry(r), segment->row(r)) != 0) ++r;
+    persisted += r;
+    if (r < count) {
+      segment->seal();  // left to the compaction
+      segments.insert(segments.begin(), segment);
+    }
+  }
+
+  LOG_INFO(logger, "Took over face store {}, {} segments, persisted {} rows kept in memory", directory,
+           segments.size(), persisted);
+}
+
+std::string face_index::segment_path(uint64_t sequence) const {
+  char name[32];
+  std::snprintf(name, sizeof(name), "%016llx%s", static_cast<unsigned long long>(sequence), SEGMENT_SUFFIX);
+  return (std::filesystem::path(directory) / name).string();
+}
+
+std::shared_ptr<face_segment> face_index::new_segment() {
+  auto sequence = next_sequence++;
+  return face_segment::create(owns_store ? segment_path(sequence) : std::string{}, precision, segment_capacity,
+                              sequence);
+}
+
+uint64_t face_index::insert(const float* embedding, int64_t now_ns) {
+  auto row = static_cast<const void*>(embedding);
+  if (precision == index_precision::INT8) {
+    for (size_t i = 0; i < EMBEDDING_DIM; ++i) row_i8[i] = quantize(embedding[i], INT8_SCALE);
+    row = row_i8.data();
+  }
+
+  std::lock_guard<std::mutex> lock(mtx);
+  return append(now_ns + ttl_ns, row);
+}
+
+uint64_t face_index::append(int64_t expires_ns, const void* row) {
+  auto id = next_id;
+  if (segments.empty() || !segments.back()->append(id, expires_ns, row)) {
+    // The full segment is sealed only once its successor exists, a failed create leaves the index as it was
+    auto next = std::shared_ptr<face_segment>{};
+    try {
+      next = new_segment();
+    } catch (const std::exception& e) {
+      LOG_ERROR(logger, "Failed to create a face segment, identity not stored: {}", e.what());
+      return 0;
+    }
+
+    if (!segments.empty()) segments.back()->seal();
+    segments.push_back(std::move(next));
+    segments.back()->append(id, expires_ns, row);
+  }
+  ++next_id;
+  return id;
+}
+
+bool face_index::refresh(const match& found, int64_t now_ns) {
+  std::lock_guard<std::mutex> lock(mtx);
+  for (const auto& segment : segments) {
+    if (segment.get() != found.segment) continue;
+    if (found.row < segment->size() && segment->id(found.row) == found.id) {
+      segment->set_expiry(found.row, now_ns + ttl_ns);
+      return true;
+    }
+    break;
+  }
+
+  // A compaction moved the row since it was found
+  for (const auto& segment : segments) {
+    for (size_t r = 0, rows = segment->size(); r < rows; ++r) {
+      if (segment->id(r) == found.id && segment->expiry(r) > now_ns) {
+        segment->set_expiry(r, now_ns + ttl_ns);
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+void face_index::score_segment(const face_segment& segment, size_t rows, const float* query) const {
+  if (precision == index_precision::FLOAT32) {
+    score_f32(segment.f32_rows(), rows, query, scores.data());
+  } else {
+    score_i8(segment.i8_rows(), rows, query_i8.data(), scores.data());
+  }
+}
+
+size_t face_index::search(const float* query, size_t k, match* out, int64_t now_ns) const {
+  if (k == 0) return 0;
+  if (precision == index_precision::INT8) {
+    for (size_t i = 0; i < EMBEDDING_DIM; ++i) query_i8[i] = quantize(query[i], INT8_SCALE);
+  }
+
+  // Keep the best k in out, sorted descending; k is tiny so insertion beats a heap
+  auto scale = precision == index_precision::INT8 ? 1.0f / (INT8_SCALE * INT8_SCALE) : 1.0f;
+  auto found = size_t{0};
+
+  std::lock_guard<std::mutex> lock(mtx);
+  for (const auto& segment : segments) {
+    auto rows = segment->size();
+    if (rows == 0) continue;
+    score_segment(*segment, rows, query);
+
+    for (size_t r = 0; r < rows; ++r) {
+      if (segment->expiry(r) <= now_ns) continue;
+
+      auto score = scores[r] * scale;
+      if (found == k && score <= out[k - 1].score) continue;
+
+      auto pos = found < k ? found++ : k - 1;
+      while (pos > 0 && out[pos - 1].score < score) {
+        out[pos] = out[pos - 1];
+        --pos;
+      }
+      out[pos] = match{segment->id(r), score, segment.get(), r};
+    }
+  }
+
+  return found;
+}
+
+size_t face_index::evict_expired(int64_t now_ns) {
+  auto expired = size_t{0};
+  auto sparse = false;
+  auto small = size_t{0};
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    for (const auto& segment : segments) {
+      auto rows = segment->size();
+      auto dead = size_t{0};
+      for (size_t r = 0; r < rows; ++r) dead += segment->expiry(r) <= now_ns;
+      expired += dead;
+
+      if (!segment->is_sealed() || segment->is_read_only()) continue;
+      sparse |= rows - dead < COMPACTION_LIVE_RATIO * rows;
+      small += rows < segment->capacity() / 2;
+    }
+  }
+
+  if (sparse || small > 1) {
+    {
+      std::lock_guard<std::mutex> lock(compaction_mtx);
+      compaction_requested = true;
+      compaction_now_ns = now_ns;
+    }
+    compaction_cv.notify_one();
+  }
+  return expired;
+}
+
+size_t face_index::size() const {
+  std::lock_guard<std::mutex> lock(mtx);
+  auto rows = size_t{0};
+  for (const auto& segment : segments) rows += segment->size();
+  return rows;
+}
+
+size_t face_index::segment_count() const {
+  std::lock_guard<std::mutex> lock(mtx);
+  return segments.size();
+}
+
+void face_index::compaction_loop() {
+  while (true) {
+    auto now_ns = int64_t{0};
+    {
+      std::unique_lock<std::mutex> lock(compaction_mtx);
+      auto woken = [this] { return compaction_requested || stopping; };
+      if (directory.empty() || owns_store) {
+        compaction_cv.wait(lock, woken);
+      } else if (!compaction_cv.wait_for(lock, LOCK_RETRY_INTERVAL, woken)) {
+        // Another process held the store at startup, take it over as soon as it lets go
+        lock.unlock();
+        if (lock_store()) take_over_store();
+        continue;
+      }
+      if (stopping) return;
+      compaction_requested = false;
+      now_ns = compaction_now_ns;
+    }
+    compact(now_ns);
+  }
+}
+
+void face_index::compact(int64_t now_ns) {
+  // Pick sealed segments that are mostly expired, and the small ones so they get merged
+  std::vector<std::shared_ptr<face_segment>> victims, small;
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    for (const auto& segment : segments) {
+      // Read-only files are the previous owner's to compact
+      if (!segment->is_sealed() || segment->is_read_only()) continue;
+      auto rows = segment->size();
+      auto live = size_t{0};
+      for (size_t r = 0; r < rows; ++r) live += segment->expiry(r) > now_ns;
+
+      if (live < COMPACTION_LIVE_RATIO * rows) {
+        victims.push_back(segment);
+      } else if (rows < segment->capacity() / 2) {
+        small.push_back(segment);
+      }
+    }
+  }
+  if (small.size() > 1) victims.insert(victims.end(), small.begin(), small.end());
+  if (victims.empty()) return;
+
+  // Copy the live rows without the lock, sealed segments only change in their expiries
+  struct moved_row {
+    const face_segment* from;
+    size_t from_row;
+    face_segment* to;
+    size_t to_row;
+  };
+  std::vector<moved_row> moved;
+  std::vector<std::shared_ptr<face_segment>> outputs;
+
+  try {
+    for (const auto& victim : victims) {
+      for (size_t r = 0, rows = victim->size(); r < rows; ++r) {
+        auto expires_ns = victim->expiry(r);
+        if (expires_ns <= now_ns) continue;
+
+        if (outputs.empty() || !outputs.back()->append(victim->id(r), expires_ns, victim->row(r))) {
+          auto sequence = next_sequence++;
+          auto path = owns_store ? segment_path(sequence) + ".tmp" : std::string{};
+          outputs.push_back(face_segment::create(path, precision, segment_capacity, sequence));
+          outputs.back()->append(victim->id(r), expires_ns, victim->row(r));
+        }
+        moved.push_back(moved_row{victim.get(), r, outputs.back().get(), outputs.back()->size() - 1});
+      }
+    }
+
+    // A crash from here on leaves a row in two segments at worst, both copies expire on their own
+    for (const auto& output : outputs) {
+      output->seal();
+      if (owns_store) output->rename(segment_path(output->get_sequence()));
+    }
+  } catch (const std::exception& e) {
+    LOG_ERROR(logger, "Face index compaction failed: {}", e.what());
+    for (const auto& output : outputs) output->remove();
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    // Carry over refreshes that raced the copy
+    for (const auto& row : moved) row.to->set_expiry(row.to_row, row.from->expiry(row.from_row));
+
+    auto is_victim = [&victims](const auto& segment) {
+      return std::find(victims.begin(), victims.end(), segment) != victims.end();
+    };
+    segments.erase(std::remove_if(segments.begin(), segments.end(), is_victim), segments.end());
+    segments.insert(segments.begin(), outputs.begin(), outputs.end());
+  }
+
+  for (const auto& victim : victims) victim->remove();
+  LOG_DEBUG(logger, "Compacted {} face segments into {}, kept {} rows", victims.size(), outputs.size(),
+            moved.size());
+}
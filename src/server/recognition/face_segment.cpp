@@ -0,0 +1,173 @@
+#include "server/recognition/face_segment.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+#include "common/chat_utils.hpp"
+
+namespace {
+constexpr size_t CACHE_LINE = 64;
+
+size_t round_up(size_t value, size_t align) { return (value + align - 1) / align * align; }
+
+size_t row_size_of(index_precision precision) {
+  return EMBEDDING_DIM * (precision == index_precision::FLOAT32 ? sizeof(float) : sizeof(int8_t));
+}
+
+size_t mapping_size_of(size_t capacity, size_t row_size) {
+  return face_segment::HEADER_SIZE + capacity * (sizeof(uint64_t) + sizeof(int64_t)) + capacity * row_size;
+}
+}  // namespace
+
+face_segment::face_segment()
+    : fd{-1},
+      read_only{false},
+      mapping{nullptr},
+      mapping_size{0},
+      row_size{0},
+      hdr{nullptr},
+      ids{nullptr},
+      expiries{nullptr},
+      rows{nullptr} {}
+
+face_segment::~face_segment() {
+  if (mapping) munmap(mapping, mapping_size);
+  if (fd >= 0) ::close(fd);
+}
+
+void face_segment::map(size_t capacity) {
+  static_assert(sizeof(header) <= HEADER_SIZE, "segment header outgrew its page");
+
+  hdr = reinterpret_cast<header*>(mapping);
+  ids = reinterpret_cast<uint64_t*>(mapping + HEADER_SIZE);
+  expiries = reinterpret_cast<int64_t*>(ids + capacity);
+  rows = reinterpret_cast<uint8_t*>(expiries + capacity);
+}
+
+auto face_segment::create(const std::string& path, index_precision precision, uint32_t capacity, uint64_t sequence)
+    -> std::unique_ptr<face_segment> {
+  auto segment = std::unique_ptr<face_segment>(new face_segment());
+  capacity = static_cast<uint32_t>(round_up(capacity == 0 ? 1 : capacity, CACHE_LINE));
+  segment->path = path;
+  segment->row_size = row_size_of(precision);
+  segment->mapping_size = mapping_size_of(capacity, segment->row_size);
+
+  void* mapping = MAP_FAILED;
+  if (path.empty()) {
+    mapping = mmap(nullptr, segment->mapping_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  } else {
+    segment->fd = ::open(path.c_str(), O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0644);
+    if (segment->fd < 0) throw std::runtime_error("Failed to create face segment " + path);
+
+    // Sparse, blocks are only allocated as records are appended
+    if (ftruncate(segment->fd, static_cast<off_t>(segment->mapping_size)) < 0) {
+      ::unlink(path.c_str());
+      throw std::runtime_error("Failed to size face segment " + path);
+    }
+    mapping = mmap(nullptr, segment->mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, segment->fd, 0);
+  }
+  if (mapping == MAP_FAILED) {
+    if (!path.empty()) ::unlink(path.c_str());
+    throw std::runtime_error("Failed to map face segment " + (path.empty() ? std::string{"(anonymous)"} : path));
+  }
+
+  segment->mapping = static_cast<uint8_t*>(mapping);
+  segment->map(capacity);
+
+  auto hdr = new (segment->mapping) header{};
+  hdr->magic = MAGIC;
+  hdr->version = VERSION;
+  hdr->dim = static_cast<uint32_t>(EMBEDDING_DIM);
+  hdr->precision = static_cast<uint32_t>(precision);
+  hdr->capacity = capacity;
+  hdr->sequence = sequence;
+  hdr->count.store(0, std::memory_order_release);
+  return segment;
+}
+
+auto face_segment::open(const std::string& path, index_precision precision, bool read_only)
+    -> std::unique_ptr<face_segment> {
+  auto segment = std::unique_ptr<face_segment>(new face_segment());
+  segment->path = path;
+  segment->row_size = row_size_of(precision);
+  segment->read_only = read_only;
+
+  segment->fd = ::open(path.c_str(), (read_only ? O_RDONLY : O_RDWR) | O_CLOEXEC);
+  if (segment->fd < 0) throw std::runtime_error("Failed to open face segment " + path);
+
+  struct stat st {};
+  if (fstat(segment->fd, &st) < 0) throw std::runtime_error("Failed to stat face segment " + path);
+  if (static_cast<size_t>(st.st_size) < HEADER_SIZE) {
+    LOG_WARNING(logger, "Ignoring face segment {}, it is truncated", path);
+    return nullptr;
+  }
+
+  // Only the header is read here, the records page in when the index first scans them
+  // A read-only segment is mapped private: pages it never writes keep following the owner's appends, refreshed
+  // expiries are copied on write and never reach the file
+  auto file_size = static_cast<size_t>(st.st_size);
+  auto mapping = mmap(nullptr, file_size, PROT_READ | PROT_WRITE, read_only ? MAP_PRIVATE : MAP_SHARED, segment->fd, 0);
+  if (mapping == MAP_FAILED) throw std::runtime_error("Failed to map face segment " + path);
+  segment->mapping = static_cast<uint8_t*>(mapping);
+  segment->mapping_size = file_size;
+
+  auto hdr = reinterpret_cast<const header*>(mapping);
+  if (hdr->magic != MAGIC || hdr->version != VERSION || hdr->dim != EMBEDDING_DIM ||
+      hdr->precision != static_cast<uint32_t>(precision)) {
+    LOG_WARNING(logger, "Ignoring face segment {}, layout version {} dim {} precision {} does not match", path,
+                hdr->version, hdr->dim, hdr->precision);
+    return nullptr;
+  }
+  if (file_size < mapping_size_of(hdr->capacity, segment->row_size) ||
+      hdr->count.load(std::memory_order_acquire) > hdr->capacity) {
+    LOG_WARNING(logger, "Ignoring face segment {}, it is truncated", path);
+    return nullptr;
+  }
+
+  segment->map(hdr->capacity);
+  return segment;
+}
+
+bool face_segment::append(uint64_t id, int64_t expires_ns, const void* row) {
+  auto n = hdr->count.load(std::memory_order_relaxed);
+  if (n == hdr->capacity || is_sealed() || read_only) return false;
+
+  ids[n] = id;
+  set_expiry(n, expires_ns);
+  std::memcpy(rows + n * row_size, row, row_size);
+  if (id > hdr->max_id.load(std::memory_order_relaxed)) hdr->max_id.store(id, std::memory_order_relaxed);
+
+  hdr->count.store(n + 1, std::memory_order_release);
+  return true;
+}
+
+void face_segment::seal() {
+  if (read_only) return;
+  hdr->sealed.store(1, std::memory_order_release);
+  flush();
+}
+
+void face_segment::rename(const std::string& new_path) {
+  if (path.empty() || read_only) return;
+  if (std::rename(path.c_str(), new_path.c_str()) < 0) {
+    throw std::runtime_error("Failed to rename face segment " + path + " to " + new_path);
+  }
+  path = new_path;
+}
+
+void face_segment::remove() {
+  if (path.empty() || read_only) return;
+  if (::unlink(path.c_str()) < 0) LOG_WARNING(logger, "Failed to remove face segment {}: {}", path, strerror(errno));
+}
+
+void face_segment::flush() const {
+  if (!path.empty() && !read_only) msync(mapping, mapping_size, MS_ASYNC);
+}
@@ -0,0 +1,32 @@
+#include "server/recognition/greeting_registry.hpp"
+
+#include <chrono>
+
+#include "common/chat_utils.hpp"
+
+greeting_registry::greeting_registry(const std::string& directory)
+    : index{index_precision::INT8, SEGMENT_CAPACITY, GREETING_TTL_NS, directory}, next_eviction_ns{0} {
+  LOG_INFO(logger, "Greeting registry using {} similarity kernels, {} identities in {} segments", index.get_kernel(),
+           index.size(), index.segment_count());
+}
+
+bool greeting_registry::resolve(const std::string& session_id, const recognition_output& result) {
+  auto now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch())
+                 .count();
+
+  if (now >= next_eviction_ns) {
+    if (auto expired = index.evict_expired(now)) LOG_DEBUG(logger, "{} greeted identities expired", expired);
+    next_eviction_ns = now + EVICTION_INTERVAL_NS;
+  }
+
+  auto best = face_index::match{};
+  if (index.search(result.embedding.data(), 1, &best, now) == 1 && best.score >= MATCH_THRESHOLD) {
+    index.refresh(best, now);
+    LOG_DEBUG(logger, "Session {} matches identity {} (score {:.3f})", session_id, best.id, best.score);
+    return true;
+  }
+
+  auto id = index.insert(result.embedding.data(), now);
+  LOG_DEBUG(logger, "Session {} greets new identity {}, {} remembered", session_id, id, index.size());
+  return false;
+}
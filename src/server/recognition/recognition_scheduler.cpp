@@ -0,0 +1,155 @@
+#include "server/recognition/recognition_scheduler.hpp"
+
+#include <algorithm>
+
+#include "common/chat_utils.hpp"
+
+recognition_scheduler::recognition_scheduler(std::unique_ptr<recognition_backend> backend)
+    : backend{std::move(backend)},
+      next_id{1},
+      sources_changed{false},
+      pending{false},
+      sleeping{false},
+      is_running{true},
+      batches{0},
+      frames_run{0} {
+  scheduler_thread = std::thread([this]() { this->schedule_work(); });
+}
+
+recognition_scheduler::~recognition_scheduler() { stop(); }
+
+void recognition_scheduler::stop() {
+  {
+    std::lock_guard<std::mutex> lock(wake_mtx);
+    is_running.store(false);
+  }
+  wake_cv.notify_all();
+
+  if (scheduler_thread.joinable()) {
+    scheduler_thread.join();
+  }
+}
+
+uint64_t recognition_scheduler::add_source(const std::string& session_id, std::shared_ptr<frame_queue> frames,
+                                           result_callback on_result) {
+  auto src = std::make_shared<source>();
+  src->session_id = session_id;
+  src->frames = std::move(frames);
+  src->on_result = std::move(on_result);
+
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    src->id = next_id++;
+    sources.push_back(src);
+    sources_changed = true;
+  }
+
+  notify();  // frames may already be waiting
+  return src->id;
+}
+
+void recognition_scheduler::remove_source(uint64_t id) {
+  std::lock_guard<std::mutex> lock(mtx);
+  auto it = std::find_if(sources.begin(), sources.end(), [id](const auto& src) { return src->id == id; });
+  if (it == sources.end()) return;
+
+  (*it)->active = false;
+  sources.erase(it);
+  sources_changed = true;
+}
+
+void recognition_scheduler::notify() {
+  pending.store(true);  // seq_cst, pairs with the sleeping flag
+  if (sleeping.load()) {
+    std::lock_guard<std::mutex> lock(wake_mtx);
+    wake_cv.notify_one();
+  }
+}
+
+void recognition_scheduler::schedule_work() {
+  auto limit = std::max<size_t>(backend->max_batch(), 1);
+  auto snapshot = std::vector<std::shared_ptr<source>>{};
+  auto batch = std::vector<entry>{};
+  auto inputs = std::vector<recognition_input>{};
+  auto outputs = std::vector<recognition_output>{};
+  batch.reserve(limit);
+  inputs.reserve(limit);
+  outputs.resize(limit);
+
+  auto next = size_t{0};  // round robin start
+  auto deadline = std::chrono::steady_clock::time_point::max();
+
+  while (is_running.load()) {
+    pending.store(false);
+
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      if (sources_changed) {
+        snapshot = sources;
+        sources_changed = false;
+      }
+    }
+
+    // One frame per source per pass, round robin so a busy robot cannot starve the others, and more passes while
+    // frames are ready: a lone robot fills the batch with consecutive frames in decode order instead of waiting out
+    // the deadline for sources that have nothing; leases pin the frames until the batch ran
+    for (auto took = true; took && batch.size() < limit;) {
+      took = false;
+      for (size_t n = 0; n < snapshot.size() && batch.size() < limit; ++n) {
+        auto& src = snapshot[(next + n) % snapshot.size()];
+        if (auto image = src->frames->try_pop()) {
+          if (batch.empty()) deadline = std::chrono::steady_clock::now() + BATCH_DEADLINE;
+          batch.push_back(entry{src, std::move(image)});
+          took = true;
+        }
+      }
+    }
+    if (!snapshot.empty()) next = (next + 1) % snapshot.size();
+
+    if (!batch.empty() && (batch.size() == limit || std::chrono::steady_clock::now() >= deadline)) {
+      run_batch(batch, inputs, outputs);
+      deadline = std::chrono::steady_clock::time_point::max();
+      continue;
+    }
+
+    // Sleep until a producer commits or the partial batch is due
+    auto until = batch.empty() ? std::chrono::steady_clock::now() + IDLE_WAIT : deadline;
+    std::unique_lock<std::mutex> lock(wake_mtx);
+    sleeping.store(true);  // seq_cst, a notify after this store sees it and takes the lock
+    wake_cv.wait_until(lock, until, [this]() { return pending.load() || !is_running.load(); });
+    sleeping.store(false);
+  }
+
+  batch.clear();  // hand the leased frames back before the queues can go away
+}
+
+void recognition_scheduler::run_batch(std::vector<entry>& batch, std::vector<recognition_input>& inputs,
+                                      std::vector<recognition_output>& outputs) {
+  inputs.clear();
+  for (auto& e : batch) inputs.push_back(recognition_input{&e.src->session_id, &*e.image});
+
+  backend->infer(inputs.data(), inputs.size(), outputs.data());
+  batches.fetch_add(1, std::memory_order_relaxed);
+  frames_run.fetch_add(batch.size(), std::memory_order_relaxed);
+
+  std::lock_guard<std::mutex> lock(mtx);
+  for (size_t i = 0; i < batch.size(); ++i) {
+    // The frame goes back to its queue first, the result no longer points into it; batch order keeps each
+    // source's leases released in the order they were taken
+    auto sampled = batch[i].image->sampled;
+    batch[i].image.release();
+
+    auto& src = *batch[i].src;
+    if (!src.active || !sampled) continue;
+
+    auto& out = outputs[i];
+    out.greeted = out.has_face && resolve_greeting && resolve_greeting(src.session_id, out);
+    if (!src.on_result(out)) {
+      src.active = false;
+      sources.erase(std::remove(sources.begin(), sources.end(), batch[i].src), sources.end());
+      sources_changed = true;
+    }
+  }
+
+  batch.clear();
+}
@@ -0,0 +1,142 @@
+#include "server/rpc/robot_registry.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+#include "common/chat_utils.hpp"
+
+namespace {
+int64_t steady_now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+const char* state_name(grpc_connectivity_state state) {
+  switch (state) {
+    case GRPC_CHANNEL_IDLE:
+      return "idle";
+    case GRPC_CHANNEL_CONNECTING:
+      return "connecting";
+    case GRPC_CHANNEL_READY:
+      return "ready";
+    case GRPC_CHANNEL_TRANSIENT_FAILURE:
+      return "failing";
+    case GRPC_CHANNEL_SHUTDOWN:
+      return "shut down";
+  }
+  return "unknown";
+}
+}  // namespace
+
+robot_registry::robot_registry() : timers{timer_wheel::shared()} {}
+
+robot_registry::~robot_registry() {
+  // Outside the lock, cancel waits for a running health check and that takes it
+  auto health_timers = std::vector<timer_wheel::timer_id>{};
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    for (const auto& [address, robot] : channels) health_timers.push_back(robot.health_timer);
+  }
+  for (auto timer : health_timers) timers->cancel(timer);
+}
+
+robot_registry::stub_ptr robot_registry::acquire(const std::string& address) {
+  auto evicted = robot_channel{};  // released after the lock, its health check takes it
+  std::unique_lock<std::mutex> lock(mtx);
+  if (auto it = channels.find(address); it != channels.end()) {
+    it->second.last_used_ns = steady_now_ns();
+    return it->second.stub;
+  }
+
+  // Full, make room by dropping the least recently used channel
+  if (channels.size() >= MAX_ROBOTS) {
+    auto oldest = std::min_element(channels.begin(), channels.end(), [](const auto& a, const auto& b) {
+      return a.second.last_used_ns < b.second.last_used_ns;
+    });
+    LOG_WARNING(logger, "{} robots known, evicting channel to robot {}", channels.size(), oldest->first);
+    evicted = std::move(oldest->second);
+    channels.erase(oldest);
+  }
+
+  auto& robot = channels[address];
+  robot.last_used_ns = steady_now_ns();
+
+  grpc::ChannelArguments args;
+  args.SetInt(GRPC_ARG_KEEPALIVE_TIME_MS, KEEPALIVE_TIME_MS);
+  args.SetInt(GRPC_ARG_KEEPALIVE_TIMEOUT_MS, KEEPALIVE_TIMEOUT_MS);
+  args.SetInt(GRPC_ARG_KEEPALIVE_PERMIT_WITHOUT_CALLS, 1);
+  args.SetInt(GRPC_ARG_HTTP2_MAX_PINGS_WITHOUT_DATA, 0);
+
+  robot.channel = grpc::CreateCustomChannel(address, grpc::InsecureChannelCredentials(), args);
+  robot.stub = robot::robot_service::NewStub(robot.channel);
+  robot.last_state = robot.channel->GetState(true);  // start connecting before the first call needs it
+  robot.health_timer = timers->schedule(HEALTH_INTERVAL, [this, address]() { check_health(address); });
+
+  LOG_INFO(logger, "Opened channel to robot {}, {} robots known", address, channels.size());
+  auto stub = robot.stub;
+  lock.unlock();
+
+  if (evicted.health_timer) timers->cancel(evicted.health_timer);
+  return stub;
+}
+
+void robot_registry::check_health(const std::string& address) {
+  auto evicted = robot_channel{};  // released after the lock, shutting a channel down can block
+  std::lock_guard<std::mutex> lock(mtx);
+  auto it = channels.find(address);
+  if (it == channels.end()) return;
+
+  auto& robot = it->second;
+  auto state = robot.channel->GetState(true);  // also reconnects a channel that dropped or went idle
+  if (state != robot.last_state) {
+    LOG_DEBUG(logger, "Channel to robot {} is {}", address, state_name(state));
+    robot.last_state = state;
+  }
+  auto failing = state == GRPC_CHANNEL_TRANSIENT_FAILURE || state == GRPC_CHANNEL_SHUTDOWN;
+  robot.failed_checks = failing ? robot.failed_checks + 1 : 0;
+
+  auto idle = std::chrono::nanoseconds{steady_now_ns() - robot.last_used_ns};
+  if (idle < IDLE_TIMEOUT && robot.failed_checks < MAX_FAILED_CHECKS) {
+    timers->rearm(robot.health_timer, HEALTH_INTERVAL);
+    return;
+  }
+
+  LOG_INFO(logger, "Evicting channel to robot {}, {}", address,
+           robot.failed_checks >= MAX_FAILED_CHECKS ? "unreachable" : "idle");
+  evicted = std::move(robot);
+  channels.erase(it);
+}
+
+std::string robot_registry::address_of(const grpc::ServerContextBase& context) {
+  // "ipv4:10.0.0.7:51234" or "ipv6:[fd00::7]:51234", the robot_service listens on the same host
+  auto peer = context.peer();
+  auto scheme_end = peer.find(':');
+  auto port_start = peer.rfind(':');
+  auto host = scheme_end == std::string::npos || port_start == scheme_end
+                  ? std::string{"localhost"}
+                  : peer.substr(scheme_end + 1, port_start - scheme_end - 1);
+
+  // Only the port is taken from the metadata, a robot cannot point the server at another host
+  auto port = ROBOT_PORT;
+  const auto& metadata = context.client_metadata();
+  if (auto it = metadata.find(ADDRESS_METADATA); it != metadata.end() && it->second.length() > 0) {
+    auto claimed = std::string{it->second.data(), it->second.length()};
+    auto separator = claimed.rfind(':');
+    auto claimed_host = separator == std::string::npos ? std::string{} : claimed.substr(0, separator);
+    auto port_text = separator == std::string::npos ? claimed : claimed.substr(separator + 1);
+    auto claimed_port = std::strtol(port_text.c_str(), nullptr, 10);
+
+    if (!claimed_host.empty() && claimed_host != host) {
+      LOG_WARNING(logger, "Robot at {} claimed address {}, using its peer host", peer, claimed);
+    }
+    if (claimed_port > 0 && claimed_port <= 65535) port = static_cast<int>(claimed_port);
+  }
+
+  return host + ":" + std::to_string(port);
+}
+
+size_t robot_registry::size() {
+  std::lock_guard<std::mutex> lock(mtx);
+  return channels.size();
+}
@@ -4,71 +4,172 @@
 #include <grpcpp/grpcpp.h>
 
 #include <chrono>
-#include <condition_variable>
 #include <mutex>
 
 #include "common/chat_utils.hpp"
+#include "server/rpc/signaling_reactor.hpp"
 #include "server/sessions/camera_receiver.hpp"
 
 using namespace std::chrono_literals;
 
-server_rpc_manager::server_rpc_manager()
-    : channel{grpc::CreateChannel("localhost:6002", grpc::InsecureChannelCredentials())},
-      stub{robot::robot_service::NewStub(channel)} {
-  // Constructor body (if needed)
-  is_running.store(true);
-  periodic_thread = std::thread([this]() {
-    while (is_running.load()) {
-      std::this_thread::sleep_for(std::chrono::seconds(1));
-      cleanup_sessions();
-    }
+server_rpc_manager::server_rpc_manager(std::unique_ptr<recognition_backend> backend,
+                                       const std::string& face_store_dir, ingest_config ingest)
+    : ingest{ingest},
+      greetings{std::make_shared<greeting_registry>(face_store_dir)},
+      scheduler{std::make_shared<recognition_scheduler>(std::move(backend))},
+      timers{timer_wheel::shared()} {
+  scheduler->set_greeting_resolver([greetings = greetings](const std::string& session_id,
+                                                           const recognition_output& result) {
+    return greetings->resolve(session_id, result);
   });
+  reaper_thread = std::thread([this]() { this->reaper_loop(); });
 }
 
 server_rpc_manager::~server_rpc_manager() {
-  is_running.store(false);
-  if (periodic_thread.joinable()) {
-    periodic_thread.join();
+  // Outside the table, cancel waits for a reclaim that is running and takes a shard lock
+  auto reclaim_timers = std::vector<timer_wheel::timer_id>{};
+  sessions.for_each([&](const std::string&, session_entry& entry) { reclaim_timers.push_back(entry.reclaim_timer); });
+  for (auto timer : reclaim_timers) timers->cancel(timer);
+
+  {
+    std::lock_guard<std::mutex> lock(reaper_mtx);
+    reaper_stopping = true;
   }
+  reaper_cv.notify_one();
+  if (reaper_thread.joinable()) reaper_thread.join();
 }
 
-grpc::Status server_rpc_manager::init_camera_stream(grpc::ServerContext* context,
-                                                    const server::init_camera_offer* request,
-                                                    server::init_camera_answer* response) {
-  // Implementation of the method
+grpc::ServerUnaryReactor* server_rpc_manager::init_camera_stream(grpc::CallbackServerContext* context,
+                                                                 const server::init_camera_offer* request,
+                                                                 server::init_camera_answer* response) {
+  auto reactor = context->DefaultReactor();
+
   if (!request || request->sdp().empty()) {
-    return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, "Empty offer SDP");
+    reactor->Finish(grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, "Empty offer SDP"));
+    return reactor;
+  }
+
+  const auto& session_id = request->session_id();
+  auto status = grpc::Status{};
+  // A one-shot receiver answers a single offer, a repeated session id must not offer to it again
+  auto receiver = create_session(session_id, robot_registry::address_of(*context), false, status);
+
+  if (!receiver) {
+    reactor->Finish(status);
+    return reactor;
   }
 
-  if (sessions.size() >= MAX_SESSIONS) {
+  // The request and response stay valid until Finish, which is called exactly once from the answer callback
+  // A receiver that could not answer is closed, its reclaim timer then erases the session
+  response->set_session_id(session_id);
+  receiver->create_receiver(request->sdp(), [reactor, response, weak = std::weak_ptr<camera_receiver>(receiver)](
+                                                const std::string& answer_sdp) {
+    if (answer_sdp.empty()) {
+      if (auto failed = weak.lock()) failed->close();
+      reactor->Finish(grpc::Status(grpc::StatusCode::INTERNAL, "Failed to create camera receiver"));
+      return;
+    }
+
+    response->set_sdp(answer_sdp);
+    reactor->Finish(grpc::Status::OK);
+  });
+
+  return reactor;
+}
+
+grpc::ServerBidiReactor<server::signal_message, server::signal_message>* server_rpc_manager::signal(
+    grpc::CallbackServerContext* context) {
+  return new signaling_reactor([this, robot_address = robot_registry::address_of(*context)](
+                                   const std::string& session_id, grpc::Status& status) {
+    return create_session(session_id, robot_address, true, status);
+  });
+}
+
+std::shared_ptr<camera_receiver> server_rpc_manager::create_session(const std::string& session_id,
+                                                                    const std::string& robot_address, bool reuse,
+                                                                    grpc::Status& status) {
+  auto existing = find_session(session_id);
+  if (existing && reuse) return existing;
+  if (existing) {
+    LOG_WARNING(logger, "Rejecting duplicate session: {}", session_id);
+    status = grpc::Status(grpc::StatusCode::ALREADY_EXISTS, "Session already exists");
+    return nullptr;
+  }
+
+  auto slot = sessions.reserve();
+  if (!slot) {
     LOG_WARNING(logger, "Max sessions reached, cannot create new session");
-    return grpc::Status(grpc::StatusCode::RESOURCE_EXHAUSTED, "Max sessions reached");
+    status = grpc::Status(grpc::StatusCode::RESOURCE_EXHAUSTED, "Max sessions reached");
+    return nullptr;
   }
 
-  const auto& session_id = request->session_id();
+  // Create a new camera receiver, no table lock is held while it is built
+  auto receiver = std::make_shared<camera_receiver>(session_id, robots.acquire(robot_address), scheduler, ingest);
+  if (add_session(std::move(slot), session_id, receiver)) return receiver;
 
-  // Create a new camera receiver
-  std::lock_guard<std::mutex> lock(mtx);
-  sessions.try_emplace(session_id, std::make_shared<camera_receiver>(session_id, stub));
-  auto receiver = std::dynamic_pointer_cast<camera_receiver>(sessions[session_id]);
+  // A concurrent request created the same session first
+  existing = find_session(session_id);
+  if (existing && reuse) return existing;
+  status = existing ? grpc::Status(grpc::StatusCode::ALREADY_EXISTS, "Session already exists")
+                    : grpc::Status(grpc::StatusCode::ABORTED, "Session was replaced concurrently");
+  return nullptr;
+}
 
-  auto answer_sdp = receiver->create_receiver(request->sdp());
+std::shared_ptr<camera_receiver> server_rpc_manager::find_session(const std::string& session_id) {
+  auto existing = sessions.find(session_id);
+  if (!existing) return nullptr;
+  if (existing->session->is_active()) return std::dynamic_pointer_cast<camera_receiver>(existing->session);
 
-  response->set_session_id(session_id);
-  response->set_sdp(answer_sdp);
+  // A reconnect under the same id gets a fresh receiver, the deactivated one is dropped now rather than by its
+  // reclaim timer, which would otherwise erase the new entry; cancel waits outside the shard lock
+  auto stale = sessions.erase_if(session_id, [](session_entry& entry) { return !entry.session->is_active(); });
+  if (stale) {
+    timers->cancel(stale->reclaim_timer);
+    LOG_INFO(logger, "Replacing inactive session: {}", session_id);
+    return nullptr;
+  }
 
-  return answer_sdp.empty() ? grpc::Status(grpc::StatusCode::INTERNAL, "Failed to create camera receiver")
-                            : grpc::Status::OK;
+  // Replaced concurrently, by an active session or by nothing
+  existing = sessions.find(session_id);
+  return existing ? std::dynamic_pointer_cast<camera_receiver>(existing->session) : nullptr;
+}
+
+bool server_rpc_manager::add_session(session_table<session_entry>::reservation&& slot, const std::string& session_id,
+                                 std::shared_ptr<base_session> session) {
+  auto timer = timers->schedule(RECLAIM_INTERVAL, [this, session_id]() { reclaim_session(session_id); });
+  session->set_on_inactive([timers = timers, timer]() { timers->rearm(timer, std::chrono::milliseconds(0)); });
+  if (sessions.insert(std::move(slot), session_id, session_entry{std::move(session), timer})) return true;
+
+  timers->cancel(timer);
+  return false;
+}
+
+void server_rpc_manager::reclaim_session(const std::string& session_id) {
+  // The erased session is released after the shard lock, tearing a session down can take a while
+  auto reclaimed = sessions.erase_if(session_id, [this](session_entry& entry) {
+    if (!entry.session->is_active()) return true;
+    timers->rearm(entry.reclaim_timer, RECLAIM_INTERVAL);
+    return false;
+  });
+  if (!reclaimed) return;
+
+  LOG_INFO(logger, "Cleaning up inactive session: {}", session_id);
+  {
+    std::lock_guard<std::mutex> lock(reaper_mtx);
+    reaped.push_back(std::move(reclaimed->session));
+  }
+  reaper_cv.notify_one();
 }
 
-void server_rpc_manager::cleanup_sessions() {
-  std::lock_guard<std::mutex> lock(mtx);
-  for (auto it = sessions.begin(); it != sessions.end();) {
-    if (!it->second->is_active()) {
-      LOG_INFO(logger, "Cleaning up inactive session: {}", it->first);
-      it = sessions.erase(it);
-    } else {
-      ++it;
+void server_rpc_manager::reaper_loop() {
+  auto batch = std::vector<std::shared_ptr<base_session>>{};
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(reaper_mtx);
+      reaper_cv.wait(lock, [this]() { return reaper_stopping || !reaped.empty(); });
+      batch.swap(reaped);
+      if (batch.empty() && reaper_stopping) return;
     }
+    batch.clear();  // the last references of the sessions, torn down outside the lock
   }
 }
\ No newline at end of file
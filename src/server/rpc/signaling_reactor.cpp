@@ -0,0 +1,116 @@
+#include "server/rpc/signaling_reactor.hpp"
+
+#include "common/chat_utils.hpp"
+
+signaling_reactor::signaling_reactor(receiver_factory make_receiver)
+    : make_receiver{std::move(make_receiver)}, outgoing{std::make_shared<write_queue<server::signal_message>>()} {
+  StartRead(&incoming);
+}
+
+void signaling_reactor::send(server::signal_message message) {
+  message.set_session_id(session_id);
+  if (auto next = outgoing->push(std::move(message))) StartWrite(next);
+}
+
+void signaling_reactor::handle_message(const server::signal_message &message) {
+  switch (message.payload_case()) {
+    case server::signal_message::kDescription: {
+      // Later offers renegotiate tracks on the same connection
+      if (receiver) {
+        if (!receiver->apply_offer(message.description().sdp())) {
+          auto reply = server::signal_message{};
+          reply.set_error("Failed to renegotiate");
+          send(std::move(reply));
+        }
+        return;
+      }
+
+      session_id = message.session_id();
+      auto status = grpc::Status{};
+      receiver = make_receiver(session_id, status);
+
+      if (!receiver) {
+        auto reply = server::signal_message{};
+        reply.set_error(status.error_message());
+        send(std::move(reply));
+        return;
+      }
+
+      // Runs on libdatachannel threads, possibly after this reactor is gone: only the queue and a copy of the
+      // session id are touched, StartWrite is only reached while the stream is still open
+      auto emit = [this, queue = outgoing, sid = session_id](server::signal_message reply) {
+        reply.set_session_id(sid);
+        if (auto next = queue->push(std::move(reply))) StartWrite(next);
+      };
+
+      auto callbacks = camera_receiver::trickle_callbacks{};
+      callbacks.on_description = [emit](const std::string &type, const std::string &sdp) {
+        auto reply = server::signal_message{};
+        reply.mutable_description()->set_type(type);
+        reply.mutable_description()->set_sdp(sdp);
+        emit(std::move(reply));
+      };
+      callbacks.on_candidate = [emit](const std::string &candidate, const std::string &mid) {
+        auto reply = server::signal_message{};
+        reply.mutable_candidate()->set_candidate(candidate);
+        reply.mutable_candidate()->set_mid(mid);
+        emit(std::move(reply));
+      };
+      callbacks.on_gathering_done = [emit]() {
+        auto reply = server::signal_message{};
+        reply.set_end_of_candidates(true);
+        emit(std::move(reply));
+      };
+
+      callbacks.on_recognition = [this, queue = outgoing](const std::string &bound_session_id,
+                                                          const recognition_output &result) {
+        // Addressed to the robot session streaming on the track, not to the link
+        auto reply = server::signal_message{};
+        reply.set_session_id(bound_session_id);
+        reply.mutable_recognition()->set_greeted(result.greeted);
+        reply.mutable_recognition()->set_confidence(result.confidence);
+        if (auto next = queue->push(std::move(reply))) StartWrite(next);
+      };
+
+      if (!receiver->accept_offer(message.description().sdp(), std::move(callbacks))) {
+        auto reply = server::signal_message{};
+        reply.set_error("Failed to create camera receiver");
+        send(std::move(reply));
+      }
+      break;
+    }
+    case server::signal_message::kCandidate:
+      if (receiver) receiver->add_remote_candidate(message.candidate().candidate(), message.candidate().mid());
+      break;
+    case server::signal_message::kBinding:
+      if (receiver) receiver->bind_track(message.binding().mid(), message.session_id(), message.binding().bound());
+      break;
+    default:
+      break;  // end of candidates needs no action
+  }
+}
+
+void signaling_reactor::OnReadDone(bool ok) {
+  if (!ok) {
+    // Robot went away, its connection lives exactly as long as the stream
+    if (receiver) receiver->close();
+
+    // Finish once the queued replies are written
+    if (outgoing->close()) Finish(grpc::Status::OK);
+    return;
+  }
+
+  handle_message(incoming);
+  StartRead(&incoming);
+}
+
+void signaling_reactor::OnWriteDone(bool ok) {
+  if (!ok) LOG_WARNING(logger, "Signaling write failed for session {}", session_id);
+
+  auto finish = false;
+  if (auto next = outgoing->pop(ok, finish)) {
+    StartWrite(next);
+  } else if (finish) {
+    Finish(grpc::Status::OK);
+  }
+}
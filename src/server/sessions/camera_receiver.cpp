@@ -3,103 +3,292 @@
 #include <chrono>
 
 #include "common/chat_utils.hpp"
+#include "common/rtp/rtcp_nack.hpp"
 
 using namespace std::chrono_literals;
 
-camera_receiver::camera_receiver(const std::string& sid, std::shared_ptr<robot::robot_service::Stub> stub)
-    : base_session{sid}, stub{stub}, pc{nullptr}, watchdog_running{false} {
-  watchdog_running.store(true);
-//   watchdog_thread = std::thread([this]() {
-//     while (watchdog_running.load()) {
-//       if (!tracks.empty() && std::chrono::steady_clock::now() - last_packet_time.load() > 1s) {
-//         LOG_WARNING(logger, "No RTP packets received for 1 second, marking session inactive");
-//         session_active.store(false);
-//       }
-//     }
-//   });
-// }
+camera_receiver::camera_receiver(const std::string& sid, std::shared_ptr<robot::robot_service::Stub> stub,
+                                 std::shared_ptr<recognition_scheduler> scheduler, ingest_config ingest)
+    : base_session{sid},
+      stub{stub},
+      scheduler{scheduler},
+      ingest{ingest},
+      pc{nullptr},
+      timers{timer_wheel::shared()},
+      watchdog_timer{0},
+      last_packet_ns{0},
+      one_shot{false} {}
 
 camera_receiver::~camera_receiver() {
-  watchdog_running.store(false);
-  if (watchdog_thread.joinable()) {
-    watchdog_thread.join();
+  // Waits for a running check, it captured this
+  if (auto timer = watchdog_timer.load()) timers->cancel(timer);
+
+  {
+    std::lock_guard<std::mutex> lock(tracks_mtx);
+    for (auto& [mid, pipeline] : tracks) stop_recognition(pipeline);
+  }
+}
+
+void camera_receiver::arm_watchdog() {
+  last_packet_ns.store(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                           std::chrono::steady_clock::now().time_since_epoch())
+                           .count());
+  if (watchdog_timer.load() != 0) return;
+
+  // Tracks open concurrently, only one timer may win: the destructor cancels the one stored here
+  auto timer = timers->schedule(IDLE_TIMEOUT, [this]() { check_idle(); });
+  auto expected = timer_wheel::timer_id{0};
+  if (!watchdog_timer.compare_exchange_strong(expected, timer)) timers->cancel(timer);
+}
+
+void camera_receiver::check_idle() {
+  auto now = std::chrono::steady_clock::now().time_since_epoch();
+  auto idle = now - std::chrono::nanoseconds{last_packet_ns.load(std::memory_order_relaxed)};
+  if (idle < IDLE_TIMEOUT) {
+    timers->rearm(watchdog_timer.load(), IDLE_TIMEOUT - idle);  // packets kept coming, wait out the rest
+    return;
   }
+
+  LOG_WARNING(logger, "No RTP packets received for {} ms, marking session {} inactive",
+              std::chrono::duration_cast<std::chrono::milliseconds>(idle).count(), session_id);
+  deactivate();
+}
+
+void camera_receiver::setup_peer_connection() {
+  rtc::Description::Video media("video", rtc::Description::Direction::RecvOnly);
+  media.addH264Codec(PAYLOAD_TYPE);
+  media.setBitrate(3000);  // Request 3Mbps (Browsers do not encode more than 2.5MBps from a webcam)
+
+  attach_track(pc->addTrack(media));
 }
 
-std::string camera_receiver::create_receiver(const std::string& offer_sdp) {
-  // Synchronization primitives
-  auto answer_sdp = std::string{};
-  auto cv = std::condition_variable{};
-  auto cv_mtx = std::mutex{};
+void camera_receiver::attach_track(std::shared_ptr<rtc::Track> track) {
+  auto mid = track->mid();
+  auto pipeline = track_pipeline{};
+  pipeline.track = track;
+  // Weak, the depacketizer may still commit a frame while the scheduler is being torn down
+  auto on_commit = std::function<void()>{};
+  if (scheduler) {
+    on_commit = [weak = std::weak_ptr<recognition_scheduler>(scheduler)]() {
+      if (auto sched = weak.lock()) sched->notify();
+    };
+  }
+  pipeline.frames = std::make_shared<frame_queue>(FRAME_QUEUE_SIZE, MAX_FRAME_SIZE, std::move(on_commit));
+  auto rtcp_session = std::make_shared<rtc::RtcpReceivingSession>();
+  auto feedback_sender = std::make_shared<rtcp_feedback_sender>();
+  track->setMediaHandler(rtcp_session);
+  track->chainMediaHandler(feedback_sender);
+
+  pipeline.depacketizer = std::make_shared<h264_depacketizer>(PAYLOAD_TYPE, pipeline.frames, JITTER_PROFILE,
+                                                              make_feedback(track, feedback_sender), ingest);
+  if (scheduler) pipeline.depacketizer->set_consumed(false);  // until a bound session starts recognition
+  track->onMessage(
+      [this, depacketizer = pipeline.depacketizer](rtc::binary message) {
+        // This is an RTP packet, reassembled in place into the track's frame queue
+        auto now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::steady_clock::now().time_since_epoch())
+                       .count();
+        last_packet_ns.store(now, std::memory_order_relaxed);
+        depacketizer->push(message.data(), message.size(), now);
+      },
+      nullptr);
+  track->onOpen([this, mid] {
+    LOG_DEBUG(logger, "track {} opened", mid);
+    if (one_shot) arm_watchdog();
+  });
+  track->onClosed([this, mid, depacketizer = pipeline.depacketizer] {
+    deactivate();
+    auto stats = depacketizer->get_stats();
+    LOG_DEBUG(logger,
+              "track {} closed, {} packets, {} lost, {} late, {} recovered, {} nacked, {} PLIs, {} frames, {} damaged, "
+              "{} skipped, {} dropped, {} filtered, jitter {} us, wait budget {} us",
+              mid, stats.packets, stats.lost, stats.late, stats.recovered, stats.nacks, stats.keyframe_requests,
+              stats.frames, stats.frames_damaged, stats.frames_skipped, stats.frames_dropped, stats.frames_filtered,
+              stats.jitter_us, stats.wait_budget_us);
+  });
+
+  // Make tracks persistent to avoid being GC'd
+  std::lock_guard<std::mutex> lock(tracks_mtx);
+  tracks[mid] = std::move(pipeline);
+  start_recognition(mid);  // the robot may have bound a session before the track was negotiated
+}
+
+void camera_receiver::start_recognition(const std::string& mid) {
+  auto track = tracks.find(mid);
+  auto binding = bindings.find(mid);
+  if (!scheduler || !on_recognition || track == tracks.end() || binding == bindings.end()) return;
+
+  auto& pipeline = track->second;
+  stop_recognition(pipeline);
+
+  // One outcome per session, the source is dropped once a face was seen and the track stops feeding its queue
+  pipeline.depacketizer->set_consumed(true);
+  pipeline.recognition_source = scheduler->add_source(
+      binding->second, pipeline.frames,
+      [on_result = on_recognition, bound_session_id = binding->second,
+       depacketizer = std::weak_ptr<h264_depacketizer>(pipeline.depacketizer)](const recognition_output& result) {
+        if (!result.has_face) return true;
+        LOG_INFO(logger, "Session {} recognized, greeted: {}", bound_session_id, result.greeted);
+        if (auto d = depacketizer.lock()) d->set_consumed(false);
+        on_result(bound_session_id, result);
+        return false;
+      });
+}
+
+void camera_receiver::stop_recognition(track_pipeline& pipeline) {
+  if (pipeline.recognition_source == 0) return;
+  pipeline.depacketizer->set_consumed(false);
+  scheduler->remove_source(pipeline.recognition_source);
+  pipeline.recognition_source = 0;
+}
+
+h264_depacketizer::feedback camera_receiver::make_feedback(std::weak_ptr<rtc::Track> track,
+                                                          std::weak_ptr<rtcp_feedback_sender> sender) {
+  // Weak, the track owns the depacketizer through its message callback and the sender through its handler chain
+  auto fb = h264_depacketizer::feedback{};
+  fb.send_nack = [track, sender](uint32_t media_ssrc, const uint16_t* seqs, size_t count) {
+    auto t = track.lock();
+    auto s = sender.lock();
+    if (!t || !s || !t->isOpen()) return;
+
+    auto packet = rtc::binary(rtcp_nack::max_size(count));
+    auto size = rtcp_nack::build(reinterpret_cast<uint8_t*>(packet.data()), RECEIVER_SSRC, media_ssrc, seqs, count);
+    packet.resize(size);
+    if (!s->queue(std::move(packet))) LOG_DEBUG(logger, "NACK dropped, feedback backlog full");
+  };
+  fb.request_keyframe = [track]() {
+    if (auto t = track.lock(); t && t->isOpen()) t->requestKeyframe();  // PLI through the RTCP session
+  };
+  return fb;
+}
+
+void camera_receiver::create_receiver(const std::string& offer_sdp, answer_callback on_answer) {
+  auto pending = std::make_shared<pending_answer>();
+  pending->on_answer = std::move(on_answer);
+  one_shot = true;
   pc = std::make_shared<rtc::PeerConnection>(config);  // Create a new PeerConnection
 
   // set up callbacks
-  pc->onGatheringStateChange(
-      [this](rtc::PeerConnection::GatheringState s) { LOG_DEBUG(logger, "Gathering state: {}", static_cast<int>(s)); });
-  pc->onLocalDescription([this](rtc::Description desc) {
+  pc->onLocalDescription([](rtc::Description desc) {
     LOG_DEBUG(logger, "Local description set: type={} size={} bytes", desc.typeString(), desc.generateSdp().size());
   });
-  pc->onGatheringStateChange([&](rtc::PeerConnection::GatheringState state) {
+  pc->onGatheringStateChange([this, pending](rtc::PeerConnection::GatheringState state) {
+    LOG_DEBUG(logger, "Gathering state: {}", static_cast<int>(state));
     if (state == rtc::PeerConnection::GatheringState::Complete) {
       auto answer = pc->localDescription();
       if (answer.has_value()) {
-        answer_sdp = answer->generateSdp();
+        auto answer_sdp = answer->generateSdp();
         LOG_DEBUG(logger, "ICE gathering complete, answer SDP size: {}", answer_sdp.size());
-        cv.notify_all();
+        pending->complete(answer_sdp);
       } else {
         LOG_ERROR(logger, "Local description not set at gathering complete");
+        pending->complete(std::string{});
       }
     }
   });
 
-  rtc::Description::Video media("video", rtc::Description::Direction::RecvOnly);
-  media.addH264Codec(96);
-  media.setBitrate(3000);  // Request 3Mbps (Browsers do not encode more than 2.5MBps from a webcam)
-
-  auto track = pc->addTrack(media);
+  setup_peer_connection();
 
-  rtcp_session = std::make_shared<rtc::RtcpReceivingSession>();
-  track->setMediaHandler(rtcp_session);
-  track->onMessage(
-      [this](rtc::binary message) {
-        // This is an RTP packet
-        LOG_DEBUG(logger, "Received RTP packet of size {} on session", message.size());
-        last_packet_time.store(std::chrono::steady_clock::now());
-      },
-      nullptr);
-  track->onOpen([this] { LOG_DEBUG(logger, "track opened"); });
-  track->onClosed([this] {
-    session_active.store(false);
-    LOG_DEBUG(logger, "track closed");
+  // Arm the timeout first, gathering may complete on another thread as soon as the answer is created
+  // The alarm only touches the shared pending state, so it is safe to fire after this receiver is gone
+  gathering_alarm.Set(std::chrono::system_clock::now() + GATHERING_TIMEOUT, [pending](bool ok) {
+    if (pending->done.load()) return;
+    if (ok) LOG_ERROR(logger, "Timeout waiting for ICE gathering to complete");
+    pending->complete(std::string{});
   });
 
-  // Make tracks persistent to avoid being GC'd
-  tracks.emplace_back(std::move(track));
-
   // Execution steps:
   // 1. Set remote description (offer from client)
   try {
     pc->setRemoteDescription(offer_sdp);
   } catch (const std::exception& e) {
     LOG_ERROR(logger, "Failed to set remote description: {}", e.what());
-    return std::string{};
+    pending->complete(std::string{});
+    return;
   }
 
-  // 2. Create and set local description (answer)
+  // 2. Create and set local description (answer), the answer is delivered when gathering completes
   try {
     auto answer = pc->createAnswer();  // calls pc->setLocalDescription() internally
   } catch (const std::exception& e) {
-    return std::string{};
+    LOG_ERROR(logger, "Failed to create answer: {}", e.what());
+    pending->complete(std::string{});
+  }
+}
+
+bool camera_receiver::accept_offer(const std::string& offer_sdp, trickle_callbacks callbacks) {
+  pc = std::make_shared<rtc::PeerConnection>(config);  // Create a new PeerConnection
+
+  // set up callbacks, the answer goes out right away and candidates trickle behind it
+  pc->onLocalDescription([on_description = std::move(callbacks.on_description)](rtc::Description desc) {
+    LOG_DEBUG(logger, "Local description set: type={} size={} bytes", desc.typeString(), desc.generateSdp().size());
+    on_description(desc.typeString(), desc.generateSdp());
+  });
+  pc->onLocalCandidate([on_candidate = std::move(callbacks.on_candidate)](rtc::Candidate candidate) {
+    on_candidate(std::string{candidate}, candidate.mid());
+  });
+  pc->onGatheringStateChange(
+      [on_gathering_done = std::move(callbacks.on_gathering_done)](rtc::PeerConnection::GatheringState state) {
+        LOG_DEBUG(logger, "Gathering state: {}", static_cast<int>(state));
+        if (state == rtc::PeerConnection::GatheringState::Complete) on_gathering_done();
+      });
+
+  on_recognition = std::move(callbacks.on_recognition);
+
+  // The robot offers a pool of tracks up front and adds more by renegotiating, accept whatever it sends
+  pc->onTrack([this](std::shared_ptr<rtc::Track> track) { attach_track(std::move(track)); });
+
+  return apply_offer(offer_sdp);
+}
+
+bool camera_receiver::apply_offer(const std::string& offer_sdp) {
+  try {
+    pc->setRemoteDescription(offer_sdp);
+    pc->createAnswer();  // calls pc->setLocalDescription() internally
+  } catch (const std::exception& e) {
+    LOG_ERROR(logger, "Failed to answer offer: {}", e.what());
+    return false;
+  }
+
+  return true;
+}
+
+bool camera_receiver::add_remote_candidate(const std::string& candidate, const std::string& mid) {
+  try {
+    pc->addRemoteCandidate(rtc::Candidate(candidate, mid));
+  } catch (const std::exception& e) {
+    LOG_WARNING(logger, "Ignoring remote candidate for session {}: {}", session_id, e.what());
+    return false;
   }
 
-  // 3. Wait for ICE gathering to complete (with timeout)
+  return true;
+}
+
+void camera_receiver::bind_track(const std::string& mid, const std::string& bound_session_id, bool bound) {
+  std::lock_guard<std::mutex> lock(tracks_mtx);
+  if (bound) {
+    bindings[mid] = bound_session_id;
+    start_recognition(mid);
+    LOG_DEBUG(logger, "Track {} of link {} now carries session {}", mid, session_id, bound_session_id);
+  } else {
+    bindings.erase(mid);
+    if (auto it = tracks.find(mid); it != tracks.end()) stop_recognition(it->second);
+    LOG_DEBUG(logger, "Track {} of link {} released by session {}", mid, session_id, bound_session_id);
+  }
+}
+
+std::shared_ptr<frame_queue> camera_receiver::get_frames(const std::string& mid) {
+  std::lock_guard<std::mutex> lock(tracks_mtx);
+  auto it = tracks.find(mid);
+  return it != tracks.end() ? it->second.frames : nullptr;
+}
+
+void camera_receiver::close() {
   {
-    auto lock = std::unique_lock<std::mutex>(cv_mtx);
-    if (!cv.wait_for(lock, 3s, [&]() { return !answer_sdp.empty(); })) {
-      LOG_ERROR(logger, "Timeout waiting for ICE gathering to complete");
-      return std::string{};
-    }
+    std::lock_guard<std::mutex> lock(tracks_mtx);
+    for (auto& [mid, pipeline] : tracks) stop_recognition(pipeline);
   }
 
-  return answer_sdp;
-}
\ No newline at end of file
+  deactivate();
+  if (pc) pc->close();
+}
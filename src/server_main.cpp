@@ -13,7 +13,12 @@ int main(int argc, char* argv[]) {
   logger->set_log_level(quill::LogLevel::TraceL3);
   quill::Backend::start();
 
-  auto server = server_rpc_manager{};
+  // Recognition runs at 10 fps, frames between samples are decoded only when later frames reference them; on an
+  // IPPP stream that is every frame, but recognition still only runs on the samples
+  // The CPU stub stands in until a real model backend is plugged in here
+  // Greeted identities are kept in CHAT_FACE_STORE (default ./faces) so a restart does not forget them
+  auto face_store = getenv("CHAT_FACE_STORE") ? getenv("CHAT_FACE_STORE") : "faces";
+  auto server = server_rpc_manager{std::make_unique<cpu_stub_backend>(), face_store, ingest_config::max_fps(10)};
 
   grpc::ServerBuilder builder;
   builder.AddListeningPort("0.0.0.0:6001", grpc::InsecureServerCredentials());
@@ -0,0 +1,137 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "server/media/frame_queue.hpp"
+#include "server/recognition/recognition_backend.hpp"
+#include "server/recognition/recognition_scheduler.hpp"
+
+// Drives the recognition scheduler with the CPU stub backend, no network or model involved
+// Exits non-zero on the first failed check
+
+#define CHECK(cond)                                                                \
+  do {                                                                             \
+    if (!(cond)) {                                                                 \
+      std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+      return 1;                                                                    \
+    }                                                                              \
+  } while (0)
+
+namespace {
+constexpr size_t QUEUE_SIZE = 16;
+constexpr size_t FRAME_SIZE = 1024;
+
+// Commits count frames at fps, every ref_every-th one sampled and the rest reference only; returns the drops
+size_t produce(frame_queue& frames, size_t count, uint32_t fps, size_t ref_every = 1) {
+  auto dropped = size_t{0};
+  auto period = std::chrono::microseconds{1'000'000 / fps};
+  auto next = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < count; ++i) {
+    std::this_thread::sleep_until(next);
+    next += period;
+
+    auto f = frames.begin_write();
+    if (!f) {
+      ++dropped;
+      continue;
+    }
+    std::memset(f->data.get(), 0, 16);
+    f->size = 16;
+    f->rtp_timestamp = static_cast<uint32_t>(i * 90000 / fps);
+    f->is_keyframe = i == 0;
+    f->is_reference = true;
+    f->sampled = i % ref_every == 0;
+    frames.commit();
+  }
+  return dropped;
+}
+
+bool wait_for(const std::atomic<size_t>& value, size_t expected) {
+  auto until = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+  while (value.load() < expected && std::chrono::steady_clock::now() < until) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  return value.load() == expected;
+}
+
+// A lone robot at 60 fps keeps up: consecutive frames share a batch instead of one frame per batch deadline
+int lone_source_keeps_up() {
+  auto scheduler = std::make_shared<recognition_scheduler>(
+      std::make_unique<cpu_stub_backend>(16, std::chrono::microseconds{2000}, std::chrono::microseconds{100}));
+  auto frames = std::make_shared<frame_queue>(QUEUE_SIZE, FRAME_SIZE, [&scheduler]() { scheduler->notify(); });
+
+  auto results = std::atomic<size_t>{0};
+  scheduler->add_source("robot-a", frames, [&results](const recognition_output& out) {
+    if (out.has_face) results.fetch_add(1);
+    return true;
+  });
+
+  auto dropped = produce(*frames, 120, 60);
+  CHECK(dropped == 0);
+  CHECK(wait_for(results, 120));
+  CHECK(scheduler->get_frames() == 120);
+  CHECK(scheduler->get_batches() < 120);
+
+  scheduler->stop();
+  return 0;
+}
+
+// Reference frames are decoded but report nothing, a source that returns false gets no further results
+int references_and_removal() {
+  auto scheduler = std::make_shared<recognition_scheduler>(std::make_unique<cpu_stub_backend>(8));
+  auto frames = std::make_shared<frame_queue>(QUEUE_SIZE, FRAME_SIZE, [&scheduler]() { scheduler->notify(); });
+
+  auto results = std::atomic<size_t>{0};
+  scheduler->add_source("robot-b", frames, [&results](const recognition_output& out) {
+    return out.has_face && results.fetch_add(1) + 1 < 2;
+  });
+
+  // Four sampled frames among twelve, the source goes away after the second result
+  CHECK(produce(*frames, 12, 120, 3) == 0);
+  CHECK(wait_for(results, 2));
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  CHECK(results.load() == 2);
+
+  scheduler->stop();
+  return 0;
+}
+
+// Two robots share the batches, both get every frame through
+int sources_share_batches() {
+  auto scheduler = std::make_shared<recognition_scheduler>(
+      std::make_unique<cpu_stub_backend>(4, std::chrono::microseconds{1000}));
+  auto a = std::make_shared<frame_queue>(QUEUE_SIZE, FRAME_SIZE, [&scheduler]() { scheduler->notify(); });
+  auto b = std::make_shared<frame_queue>(QUEUE_SIZE, FRAME_SIZE, [&scheduler]() { scheduler->notify(); });
+
+  auto results_a = std::atomic<size_t>{0};
+  auto results_b = std::atomic<size_t>{0};
+  scheduler->add_source("robot-a", a, [&results_a](const recognition_output&) { return ++results_a, true; });
+  scheduler->add_source("robot-b", b, [&results_b](const recognition_output&) { return ++results_b, true; });
+
+  auto dropped_b = size_t{0};
+  auto producer_b = std::thread([&]() { dropped_b = produce(*b, 60, 30); });
+  auto dropped_a = produce(*a, 60, 30);
+  producer_b.join();
+
+  CHECK(dropped_a == 0 && dropped_b == 0);
+  CHECK(wait_for(results_a, 60));
+  CHECK(wait_for(results_b, 60));
+
+  scheduler->stop();
+  return 0;
+}
+}  // namespace
+
+int main() {
+  auto failed = 0;
+  failed += lone_source_keeps_up();
+  failed += references_and_removal();
+  failed += sources_share_batches();
+
+  std::printf("%s\n", failed == 0 ? "all checks passed" : "checks failed");
+  return failed == 0 ? 0 : 1;
+}